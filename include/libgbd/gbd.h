@@ -6,6 +6,7 @@
 #include <stdio.h>
 
 #include "rdram.h"
+#include "symbols.h"
 #include "libgfxd/gfxd.h"
 
 typedef struct {
@@ -13,6 +14,14 @@ typedef struct {
     gfxd_ucode_t ucode;
 } gfx_ucode_registry_t;
 
+enum gbd_folded_weight {
+    GBD_FOLDED_CMDS,
+    GBD_FOLDED_TRIS,
+    GBD_FOLDED_VERTS,
+    GBD_FOLDED_RSP_CYCLES,
+    GBD_FOLDED_RDP_CYCLES,
+};
+
 typedef struct {
     bool quiet;
     bool print_vertices;
@@ -22,6 +31,15 @@ typedef struct {
     bool print_multi_packet;
     bool hex_color;
     bool q_macros;
+    bool report_dup_textures; // Lists identical textures loaded from different addresses
+    bool tmem_report;         // Summarizes texture load bandwidth and TMEM occupancy
+    bool profile_disp;        // Attributes work to OpenDisp/CloseDisp sites
+    bool cost_report;         // Estimates RSP and RDP cycles for the task and each display list
+    bool redundant_report;    // Finds state changes that set a value already in place
+    bool vtx_cache_report;    // Reports vertices loaded but never used and vertices reloaded while cached
+    bool tri_report;          // Counts culled, off-screen, sub-pixel and clipped triangles
+    bool material_report;     // Compares state changes between draw batches as drawn against sorted by material
+    bool task_stats;          // Prints stack depths, Gfx executed and gfx pool usage
 
     int to_num; // Runs to command number and stops
 
@@ -30,6 +48,15 @@ typedef struct {
     bool all_depth_cull; // Forces SPBranchLessZ to always fail
 
     char *string_encoding;
+
+    const char            *folded_path;     // Writes folded call stacks for flamegraph tools to this file
+    enum gbd_folded_weight folded_weight;   // What each folded stack is weighted by
+    const gbd_symbols_t   *symbols;         // Names display lists in output, may be NULL
+    const char            *overdraw_path;   // Writes an overdraw heatmap of the most drawn color image to this file
+    const char            *optimize_path;   // Writes the display list at the start address, rewritten, to this file
+    const char            *optimize_c_path; // Writes the rewritten display list as a C listing to this file
+    uint32_t               pool_start;      // Physical bounds of the gfx pool for task_stats, empty if unknown
+    uint32_t               pool_end;
 } gbd_options_t;
 
 enum start_location_type {
@@ -43,8 +70,17 @@ struct start_location_info {
     uint32_t                 start_location_ptr;
 };
 
+// Summary of a single analysis, for callers that do not want to parse the printed output
+typedef struct {
+    bool task_done;       // Whether the graphics task ran to completion without crashing
+    int  n_gfx;           // Number of commands executed
+    int  n_warnings;      // Number of warnings raised
+    int  n_errors;        // Number of errors raised
+    int  first_error_num; // Command number of the first error, -1 if there were none
+} gbd_result_t;
+
 int
 analyze_gbi(FILE *print_out, gfx_ucode_registry_t *ucodes, gbd_options_t *opts, rdram_interface_t *rdram,
-            const void *rdram_arg, struct start_location_info *start_location);
+            const void *rdram_arg, struct start_location_info *start_location, gbd_result_t *result);
 
 #endif
@@ -7,16 +7,72 @@
 
 // clang-format off
 typedef struct {
-    int    (*close)     (void);
-    int    (*open)      (const void *arg);
-    long   (*pos)       (void);
-    bool   (*addr_valid)(uint32_t addr);
-    size_t (*read)      (void *buf, size_t elem_size, size_t elem_count);
-    bool   (*seek)      (uint32_t addr);
-    bool   (*read_at)   (void *buf, uint32_t addr, size_t size);
+    int    (*close)      (void);
+    int    (*open)       (const void *arg);
+    long   (*pos)        (void);
+    bool   (*addr_valid) (uint32_t addr);
+    size_t (*read)       (void *buf, size_t elem_size, size_t elem_count);
+    bool   (*seek)       (uint32_t addr);
+    bool   (*read_at)    (void *buf, uint32_t addr, size_t size);
+    bool   (*range_valid)(uint32_t addr, size_t size); // optional, for images with unmapped holes
 } rdram_interface_t;
 // clang-format on
 
+// Byte order of an RDRAM image
+enum rdram_order {
+    RDRAM_ORDER_AUTO,    // detect from the image
+    RDRAM_ORDER_BIG,     // native N64 order, what gbd expects
+    RDRAM_ORDER_SWAPPED, // bytes swapped within each 16-bit halfword (.v64)
+    RDRAM_ORDER_LITTLE,  // 32-bit words stored little-endian (most emulators)
+};
+
+// Argument to rdram_interface_buffer's open, the buffer must outlive the interface being open
+typedef struct {
+    const void *data;
+    size_t      size;
+} rdram_buffer_arg_t;
+
+// Argument to rdram_interface_pack's open, selects one frame of a multi-frame pack file
+typedef struct {
+    const char *path;
+    unsigned    frame;
+} rdram_pack_arg_t;
+
+// Argument to rdram_interface_regions's open, a partial dump and the manifest of the address ranges it holds
+typedef struct {
+    const char *path;
+    const char *manifest;
+} rdram_regions_arg_t;
+
+// Argument to rdram_interface_cache's open, the interface to cache reads from and its own open argument
+typedef struct {
+    rdram_interface_t *inner;
+    const void        *inner_arg;
+} rdram_cache_arg_t;
+
+// Argument to rdram_interface_live's open, a source string shm:<name>[:<offset>] or pid:<pid>:<addr>[:<size>] and the
+// byte order the emulator keeps RDRAM in, reads are converted to big-endian
+typedef struct {
+    const char      *source;
+    enum rdram_order order;
+} rdram_live_arg_t;
+
+typedef struct {
+    unsigned long hits;     // page lookups served from the cache
+    unsigned long misses;   // page lookups that read from the wrapped interface
+    unsigned long bypassed; // reads of pages that could not be cached whole
+} rdram_cache_stats_t;
+
 extern rdram_interface_t rdram_interface_file;
+extern rdram_interface_t rdram_interface_buffer;
+extern rdram_interface_t rdram_interface_pack;
+extern rdram_interface_t rdram_interface_compressed;
+extern rdram_interface_t rdram_interface_regions;
+extern rdram_interface_t rdram_interface_live;
+extern rdram_interface_t rdram_interface_gdb; // arg is the stub's address, <host>:<port> or unix:<path>
+extern rdram_interface_t rdram_interface_cache;
+
+void
+rdram_cache_stats(rdram_cache_stats_t *stats);
 
 #endif
@@ -0,0 +1,27 @@
+#ifndef SYMBOLS_H_
+#define SYMBOLS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t addr;
+    char    *name;
+} gbd_symbol_t;
+
+// Symbol map used to name addresses in output, sorted by address
+typedef struct {
+    gbd_symbol_t *syms;
+    size_t        count;
+} gbd_symbols_t;
+
+int
+gbd_symbols_load(gbd_symbols_t *symbols, const char *path);
+
+void
+gbd_symbols_free(gbd_symbols_t *symbols);
+
+const gbd_symbol_t *
+gbd_symbols_lookup(const gbd_symbols_t *symbols, uint32_t addr);
+
+#endif
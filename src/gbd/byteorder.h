@@ -0,0 +1,18 @@
+#ifndef BYTEORDER_H_
+#define BYTEORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libgbd/rdram.h"
+
+int
+rdram_order_parse(const char *name, enum rdram_order *order);
+
+enum rdram_order
+rdram_order_detect(const void *data, size_t size);
+
+void
+rdram_order_normalize(void *data, size_t size, enum rdram_order order);
+
+#endif
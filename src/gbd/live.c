@@ -0,0 +1,86 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "libgbd/gbd.h"
+#include "live.h"
+
+/**
+ *  Watch Mode
+ *
+ *  Re-runs the analysis on a running emulator's RDRAM every time a frame counter in RAM changes, making gbd a live
+ *  validator. The emulator's memory is attached to once and the counter is polled until the emulator goes away.
+ */
+
+#define LIVE_POLL_INTERVAL_NS 5000000 // 5ms, well under a frame at 60Hz
+
+#define LIVE_PHYS_MASK 0x1FFFFFFF
+
+// The live interface stays open for the whole watch, the analysis only borrows it
+static int
+live_open_attached(const void *arg)
+{
+    return 0;
+}
+
+static int
+live_close_attached(void)
+{
+    return 0;
+}
+
+/**
+ * Reads the frame counter, returns false if the emulator has gone away.
+ */
+static bool
+live_read_counter(uint32_t counter_addr, uint32_t *counter)
+{
+    return rdram_live_alive() &&
+           rdram_interface_live.read_at(counter, counter_addr & LIVE_PHYS_MASK, sizeof(*counter));
+}
+
+/**
+ * Analyzes the RDRAM at the live `source` each time the 32-bit value at `counter_addr` changes, until it can no
+ * longer be read.
+ */
+int
+live_watch(const rdram_live_arg_t *source, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
+           struct start_location_info *start_location, uint32_t counter_addr)
+{
+    struct timespec   interval = { 0, LIVE_POLL_INTERVAL_NS };
+    rdram_interface_t attached = rdram_interface_live;
+    uint32_t          last;
+    uint32_t          counter;
+
+    attached.open  = live_open_attached;
+    attached.close = live_close_attached;
+
+    if (rdram_interface_live.open(source) != 0 || !live_read_counter(counter_addr, &last)) {
+        printf("Could not read frame counter from %s.\n", source->source);
+        rdram_interface_live.close();
+        return -1;
+    }
+
+    while (true) {
+        nanosleep(&interval, NULL);
+
+        if (!live_read_counter(counter_addr, &counter))
+            break;
+        if (counter == last)
+            continue;
+        last = counter;
+
+        gbd_result_t result;
+
+        printf("=== Frame counter changed (0x%08X) ===\n", counter);
+        if (analyze_gbi(stdout, ucodes, opts, &attached, NULL, start_location, &result) == 0)
+            printf("=== %d commands, %d warnings, %d errors ===\n", result.n_gfx, result.n_warnings,
+                   result.n_errors);
+        fflush(stdout);
+    }
+
+    printf("Lost %s, stopping.\n", source->source);
+    rdram_interface_live.close();
+    return 0;
+}
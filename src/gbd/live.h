@@ -0,0 +1,17 @@
+#ifndef LIVE_H_
+#define LIVE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libgbd/gbd.h"
+#include "libgbd/rdram.h"
+
+int
+live_watch(const rdram_live_arg_t *source, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
+           struct start_location_info *start_location, uint32_t counter_addr);
+
+bool
+rdram_live_alive(void);
+
+#endif
@@ -1,10 +1,18 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
 #include "libgbd/gbd.h"
+#include "byteorder.h"
+#include "pack.h"
+#include "rdram_compressed.h"
+#include "live.h"
+#include "savestate.h"
+#include "serve.h"
+#include "stream.h"
 
 #define strequ(s1, s2) (strcmp((s1), (s2)) == 0)
 
@@ -16,26 +24,115 @@ file_exists(const char *filename)
     return stat(filename, &buffer) == 0;
 }
 
+/**
+ * Reads a RAM dump that is not big-endian fully into memory and converts it, returns -1 if the dump is already
+ * big-endian and can be read directly.
+ */
 static int
-usage(char *exec_name)
+load_normalized(const char *file_name, enum rdram_order order, rdram_buffer_arg_t *out)
 {
-    printf("Usage: %s "
-           "[--print-textures] "
-           "[--print-vertices] "
-           "[--print-matrices] "
-           "[--print-lights] "
-           "[--to-num <n>] "
-           "[--encoding <encoding>] "
-           "[--quiet] "
-           "<file path> "
-           "<WORK_DISP start | *<pointer to WORK_DISP start>>"
-           "\n",
-           exec_name);
+    FILE   *f = fopen(file_name, "rb");
+    uint8_t first[4];
+    long    size;
+
+    if (f == NULL)
+        return -1;
+
+    if (order == RDRAM_ORDER_AUTO)
+        order = rdram_order_detect(first, fread(first, 1, sizeof(first), f));
+
+    uint8_t *data = NULL;
+    if (order == RDRAM_ORDER_BIG || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) <= 0 ||
+        (data = malloc(size)) == NULL || fseek(f, 0, SEEK_SET) != 0 || fread(data, size, 1, f) != 1) {
+        free(data);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    rdram_order_normalize(data, size, order);
+    out->data = data;
+    out->size = size;
+    return 0;
+}
+
+/**
+ * Loads the symbol map at `path`. The most recently loaded map is kept so that repeated requests to a server using the
+ * same map only read it once.
+ */
+static const gbd_symbols_t *
+load_symbols(const char *path)
+{
+    static gbd_symbols_t symbols;
+    static char         *symbols_path;
+
+    if (symbols_path != NULL && strequ(symbols_path, path))
+        return &symbols;
+
+    gbd_symbols_free(&symbols);
+    free(symbols_path);
+    symbols_path = NULL;
+
+    if (gbd_symbols_load(&symbols, path) != 0)
+        return NULL;
+    symbols_path = strdup(path);
+    return &symbols;
+}
+
+static int
+usage(FILE *out, const char *exec_name)
+{
+    fprintf(out,
+            "Usage: %s "
+            "[--print-textures] "
+            "[--print-vertices] "
+            "[--print-matrices] "
+            "[--print-lights] "
+            "[--report-dup-textures] "
+            "[--tmem-report] "
+            "[--profile-disp] "
+            "[--cost] "
+            "[--overdraw <output path>] "
+            "[--optimize <binary output path> <C output path>] "
+            "[--redundant] "
+            "[--vtx-cache] "
+            "[--tri-report] "
+            "[--material-sort] "
+            "[--stats] "
+            "[--pool <start address> <end address>] "
+            "[--folded <output path>] "
+            "[--folded-weight <cmds | tris | verts | rsp-cycles | rdp-cycles>] "
+            "[--symbols <symbol map path>] "
+            "[--to-num <n>] "
+            "[--encoding <encoding>] "
+            "[--quiet] "
+            "[--stream] "
+            "[--frame <n>] "
+            "[--regions <manifest path>] "
+            "[--live] "
+            "[--gdb] "
+            "[--byte-order <auto | big | swapped | little>] "
+            "[--cache-stats] "
+            "[--watch <frame counter address>] "
+            "<file path | stream path | - | live source | gdb stub address> "
+            "<WORK_DISP start | *<pointer to WORK_DISP start>>"
+            "\n"
+            "       %s optimize <binary output path> <C output path> [options] <file path> <display list address>"
+            "\n"
+            "       %s pack <output path> <file path>..."
+            "\n"
+            "       %s --serve <socket path>"
+            "\n",
+            exec_name, exec_name, exec_name, exec_name);
     return -1;
 }
 
-int
-main(int argc, char **argv)
+/**
+ * Runs one analysis as described by the command line in `argv`, printing to `out`. When `serving` the modes that run
+ * indefinitely are refused.
+ */
+static int
+run(int argc, char **argv, FILE *out, bool serving, gbd_result_t *result)
 {
     /* MQ debug ROM ucodes, TODO make ucodes externally configurable */
     gfx_ucode_registry_t ucodes[] = {
@@ -54,11 +151,17 @@ main(int argc, char **argv)
     const char                *file_name = NULL;
     struct start_location_info start_location;
 
-    if (argc < 3)
-        return usage(argv[0]);
-
-    bool got_file_name = false;
-    bool got_all_args  = false;
+    bool             got_file_name    = false;
+    bool             got_all_args     = false;
+    bool             stream_mode      = false;
+    unsigned         frame            = 0;
+    const char      *regions_manifest = NULL;
+    bool             live_mode        = false;
+    bool             gdb_mode         = false;
+    bool             watch            = false;
+    uint32_t         watch_addr       = 0;
+    enum rdram_order order            = RDRAM_ORDER_AUTO;
+    bool             cache_stats      = false;
 
     for (int i = 1; i < argc; i++) {
         if (strequ(argv[i], "--print-textures"))
@@ -71,18 +174,113 @@ main(int argc, char **argv)
             opts.print_lights = true;
         else if (strequ(argv[i], "--print-multi-packet"))
             opts.print_multi_packet = true;
+        else if (strequ(argv[i], "--report-dup-textures"))
+            opts.report_dup_textures = true;
+        else if (strequ(argv[i], "--tmem-report"))
+            opts.tmem_report = true;
+        else if (strequ(argv[i], "--profile-disp"))
+            opts.profile_disp = true;
+        else if (strequ(argv[i], "--cost"))
+            opts.cost_report = true;
+        else if (strequ(argv[i], "--redundant"))
+            opts.redundant_report = true;
+        else if (strequ(argv[i], "--vtx-cache"))
+            opts.vtx_cache_report = true;
+        else if (strequ(argv[i], "--tri-report"))
+            opts.tri_report = true;
+        else if (strequ(argv[i], "--material-sort"))
+            opts.material_report = true;
+        else if (strequ(argv[i], "--stats"))
+            opts.task_stats = true;
         else if (strequ(argv[i], "--quiet"))
             opts.quiet = true;
+        else if (strequ(argv[i], "--stream"))
+            stream_mode = true;
+        else if (strequ(argv[i], "--live"))
+            live_mode = true;
+        else if (strequ(argv[i], "--gdb"))
+            gdb_mode = true;
+        else if (strequ(argv[i], "--cache-stats"))
+            cache_stats = true;
         // TODO formatting options:
         //  - display list stack indentation
         //  - hide empty display lists
         else if (strequ(argv[i], "--to-num")) {
             if (i + 1 >= argc || sscanf(argv[i + 1], "%d", &opts.to_num) != 1)
-                return usage(argv[0]);
+                return usage(out, argv[0]);
+            i++;
+        } else if (strequ(argv[i], "--frame")) {
+            if (i + 1 >= argc || sscanf(argv[i + 1], "%u", &frame) != 1)
+                return usage(out, argv[0]);
+            i++;
+        } else if (strequ(argv[i], "--watch")) {
+            if (i + 1 >= argc || sscanf(argv[i + 1], "0x%8x", &watch_addr) != 1)
+                return usage(out, argv[0]);
+            i++;
+            watch     = true;
+            live_mode = true;
+        } else if (strequ(argv[i], "--folded")) {
+            if (i + 1 >= argc)
+                return usage(out, argv[0]);
+            i++;
+            opts.folded_path = argv[i];
+        } else if (strequ(argv[i], "--overdraw")) {
+            if (i + 1 >= argc)
+                return usage(out, argv[0]);
+            i++;
+            opts.overdraw_path = argv[i];
+        } else if (strequ(argv[i], "--pool")) {
+            if (i + 2 >= argc || sscanf(argv[i + 1], "0x%8x", &opts.pool_start) != 1 ||
+                sscanf(argv[i + 2], "0x%8x", &opts.pool_end) != 1)
+                return usage(out, argv[0]);
+            i += 2;
+            // Pool bounds are compared against physical addresses
+            opts.pool_start &= 0x1FFFFFFF;
+            opts.pool_end &= 0x1FFFFFFF;
+            opts.task_stats = true;
+        } else if (strequ(argv[i], "--optimize")) {
+            if (i + 2 >= argc)
+                return usage(out, argv[0]);
+            opts.optimize_path   = argv[i + 1];
+            opts.optimize_c_path = argv[i + 2];
+            i += 2;
+        } else if (strequ(argv[i], "--folded-weight")) {
+            if (i + 1 >= argc)
+                return usage(out, argv[0]);
+            i++;
+            if (strequ(argv[i], "cmds"))
+                opts.folded_weight = GBD_FOLDED_CMDS;
+            else if (strequ(argv[i], "tris"))
+                opts.folded_weight = GBD_FOLDED_TRIS;
+            else if (strequ(argv[i], "verts"))
+                opts.folded_weight = GBD_FOLDED_VERTS;
+            else if (strequ(argv[i], "rsp-cycles"))
+                opts.folded_weight = GBD_FOLDED_RSP_CYCLES;
+            else if (strequ(argv[i], "rdp-cycles"))
+                opts.folded_weight = GBD_FOLDED_RDP_CYCLES;
+            else
+                return usage(out, argv[0]);
+        } else if (strequ(argv[i], "--symbols")) {
+            if (i + 1 >= argc)
+                return usage(out, argv[0]);
+            i++;
+            opts.symbols = load_symbols(argv[i]);
+            if (opts.symbols == NULL) {
+                fprintf(out, "Could not read symbols from %s.\n", argv[i]);
+                return -1;
+            }
+        } else if (strequ(argv[i], "--byte-order")) {
+            if (i + 1 >= argc || rdram_order_parse(argv[i + 1], &order) != 0)
+                return usage(out, argv[0]);
+            i++;
+        } else if (strequ(argv[i], "--regions")) {
+            if (i + 1 >= argc)
+                return usage(out, argv[0]);
             i++;
+            regions_manifest = argv[i];
         } else if (strequ(argv[i], "--encoding")) {
             if (i + 1 >= argc)
-                return usage(argv[0]);
+                return usage(out, argv[0]);
             i++;
             opts.string_encoding = argv[i];
         } else {
@@ -110,7 +308,7 @@ main(int argc, char **argv)
                         addrp    = &start_location.start_location;
                     }
                     if (sscanf(addr_str, "0x%8x", addrp) != 1) {
-                        printf("Bad start address.\n");
+                        fprintf(out, "Bad start address.\n");
                         return -1;
                     }
                 }
@@ -118,8 +316,10 @@ main(int argc, char **argv)
             } else {
                 // file name
                 file_name = argv[i];
-                if (!file_exists(file_name)) {
-                    printf("File %s does not exist.\n", file_name);
+                // streams may be stdin or a FIFO that is created later and live sources and gdb stubs are not files,
+                // so these are checked when opened
+                if (!stream_mode && !live_mode && !gdb_mode && !file_exists(file_name)) {
+                    fprintf(out, "File %s does not exist.\n", file_name);
                     return -1;
                 }
                 got_file_name = true;
@@ -128,8 +328,127 @@ main(int argc, char **argv)
     }
 
     if (!got_all_args)
-        return usage(argv[0]);
-    analyze_gbi(stdout, ucodes, &opts, &rdram_interface_file, file_name, &start_location);
+        return usage(out, argv[0]);
 
-    return 0;
+    if (opts.optimize_path != NULL) {
+        // Only the rewritten display list is of interest, and every command in it must be seen
+        opts.quiet          = true;
+        opts.no_volume_cull = true;
+        opts.all_depth_cull = true;
+    }
+
+    if (serving && (stream_mode || watch)) {
+        fprintf(out, "--stream and --watch are not available when serving.\n");
+        return -1;
+    }
+
+    if (stream_mode)
+        return stream_analyze(file_name, ucodes, &opts, &start_location, order);
+
+    rdram_live_arg_t live_arg = {
+        .source = file_name,
+        .order  = order,
+    };
+
+    if (watch)
+        return live_watch(&live_arg, ucodes, &opts, &start_location, watch_addr);
+
+    rdram_interface_t  *rdram;
+    const void         *rdram_arg;
+    rdram_regions_arg_t regions_arg;
+    rdram_pack_arg_t    pack_arg;
+    rdram_buffer_arg_t  buffer_arg = { NULL, 0 };
+
+    if (gdb_mode) {
+        rdram     = &rdram_interface_gdb;
+        rdram_arg = file_name;
+    } else if (live_mode) {
+        rdram     = &rdram_interface_live;
+        rdram_arg = &live_arg;
+    } else if (regions_manifest != NULL) {
+        regions_arg = (rdram_regions_arg_t){
+            .path     = file_name,
+            .manifest = regions_manifest,
+        };
+        rdram     = &rdram_interface_regions;
+        rdram_arg = &regions_arg;
+    } else if (pack_file_detect(file_name)) {
+        pack_arg = (rdram_pack_arg_t){
+            .path  = file_name,
+            .frame = frame,
+        };
+        rdram     = &rdram_interface_pack;
+        rdram_arg = &pack_arg;
+    } else if (savestate_detect(file_name)) {
+        if (savestate_load(file_name, &buffer_arg) != 0) {
+            fprintf(out, "Could not read RDRAM from savestate %s\n", file_name);
+            return -1;
+        }
+        rdram     = &rdram_interface_buffer;
+        rdram_arg = &buffer_arg;
+    } else if (rdram_compressed_detect(file_name)) {
+        rdram     = &rdram_interface_compressed;
+        rdram_arg = file_name;
+    } else if (load_normalized(file_name, order, &buffer_arg) == 0) {
+        rdram     = &rdram_interface_buffer;
+        rdram_arg = &buffer_arg;
+    } else {
+        rdram     = &rdram_interface_file;
+        rdram_arg = file_name;
+    }
+
+    int ret;
+
+    if (rdram == &rdram_interface_buffer || rdram == &rdram_interface_gdb) {
+        // Already in memory, or already cached with prefetching of sequential reads that a cache in front would hide
+        ret = analyze_gbi(out, ucodes, &opts, rdram, rdram_arg, &start_location, result);
+    } else {
+        rdram_cache_arg_t cache_arg = {
+            .inner     = rdram,
+            .inner_arg = rdram_arg,
+        };
+        ret = analyze_gbi(out, ucodes, &opts, &rdram_interface_cache, &cache_arg, &start_location, result);
+
+        if (cache_stats) {
+            rdram_cache_stats_t stats;
+            unsigned long       lookups;
+
+            rdram_cache_stats(&stats);
+            lookups = stats.hits + stats.misses;
+            fprintf(out, "RDRAM cache: %lu hits, %lu misses (%.1f%% hit rate), %lu uncached reads\n", stats.hits,
+                    stats.misses, (lookups != 0) ? 100.0 * stats.hits / lookups : 0.0, stats.bypassed);
+        }
+    }
+    free((void *)buffer_arg.data);
+
+    return ret;
+}
+
+static int
+serve_request(int argc, char **argv, FILE *out, gbd_result_t *result)
+{
+    return run(argc, argv, out, true, result);
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 3)
+        return usage(stdout, argv[0]);
+
+    if (strequ(argv[1], "pack")) {
+        if (argc < 4)
+            return usage(stdout, argv[0]);
+        return pack_write(argv[2], &argv[3], argc - 3);
+    }
+
+    if (strequ(argv[1], "--serve"))
+        return serve(argv[2], serve_request);
+
+    if (strequ(argv[1], "optimize")) {
+        // Shorthand for --optimize, which takes the same two paths
+        argv[1] = "--optimize";
+    }
+
+    return run(argc, argv, stdout, false, NULL);
 }
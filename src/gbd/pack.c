@@ -0,0 +1,186 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pack.h"
+#include "../libgbd/hashmap.h"
+#include "../libgbd/xxhash.h"
+
+/**
+ *  Pack Writer
+ */
+
+typedef struct {
+    uint32_t *table;
+    uint32_t  size;
+} PackFrame;
+
+bool
+pack_file_detect(const char *path)
+{
+    char  magic[sizeof(PACK_MAGIC)];
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL)
+        return false;
+
+    bool is_pack = fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, PACK_MAGIC, sizeof(magic)) == 0;
+    fclose(f);
+    return is_pack;
+}
+
+/**
+ * Returns the index of a page with identical contents that was already written, or -1 if there is none.
+ */
+static long
+pack_find_page(HashMap *pages, FILE *out, uint64_t hash, const uint8_t *page)
+{
+    void *found = hashmap_get(pages, hash);
+    if (found == NULL)
+        return -1;
+
+    // Confirm the contents match in case of a hash collision
+    uint8_t other[PACK_PAGE_SIZE];
+    long    index = (long)(uintptr_t)found - 1;
+    long    end   = ftell(out);
+
+    bool match = fseek(out, PACK_HEADER_SIZE + index * PACK_PAGE_SIZE, SEEK_SET) == 0 &&
+                 fread(other, sizeof(other), 1, out) == 1 && memcmp(other, page, sizeof(other)) == 0;
+
+    fseek(out, end, SEEK_SET);
+    return match ? index : -1;
+}
+
+static int
+pack_add_frame(PackFrame *frame, FILE *in, FILE *out, HashMap *pages, uint32_t *n_pages)
+{
+    uint8_t page[PACK_PAGE_SIZE];
+    size_t  n_read;
+    size_t  capacity = 0;
+    size_t  n        = 0;
+
+    frame->table = NULL;
+    frame->size  = 0;
+
+    while ((n_read = fread(page, 1, sizeof(page), in)) != 0) {
+        // The last page is zero-padded
+        memset(&page[n_read], 0, sizeof(page) - n_read);
+        frame->size += n_read;
+
+        uint64_t hash  = xxh64(page, sizeof(page), 0);
+        long     index = pack_find_page(pages, out, hash, page);
+
+        if (index < 0) {
+            index = (*n_pages)++;
+            if (fwrite(page, sizeof(page), 1, out) != 1 ||
+                hashmap_put(pages, hash, (void *)(uintptr_t)(index + 1)) != 0)
+                return -1;
+        }
+
+        if (n == capacity) {
+            capacity         = (capacity == 0) ? 2048 : capacity * 2;
+            uint32_t *resize = realloc(frame->table, capacity * sizeof(uint32_t));
+            if (resize == NULL)
+                return -1;
+            frame->table = resize;
+        }
+        frame->table[n++] = index;
+    }
+    return ferror(in) ? -1 : 0;
+}
+
+/**
+ * Writes the RDRAM dumps at `in_paths` as consecutive frames of a new pack at `out_path`.
+ */
+int
+pack_write(const char *out_path, char **in_paths, int n_in)
+{
+    uint8_t    header[PACK_HEADER_SIZE] = { 0 };
+    uint32_t   n_pages                  = 0;
+    uint64_t   total_size               = 0;
+    int        ret                      = -1;
+    PackFrame *frames                   = calloc(n_in, sizeof(PackFrame));
+    HashMap    pages;
+
+    hashmap_new(&pages);
+
+    FILE *out = fopen(out_path, "w+b");
+    if (frames == NULL || out == NULL) {
+        printf("Could not open %s for writing.\n", out_path);
+        goto done;
+    }
+
+    // Header is written last once the counts are known
+    if (fwrite(header, sizeof(header), 1, out) != 1)
+        goto write_err;
+
+    for (int i = 0; i < n_in; i++) {
+        FILE *in = fopen(in_paths[i], "rb");
+        if (in == NULL) {
+            printf("Could not open %s.\n", in_paths[i]);
+            goto done;
+        }
+
+        int err = pack_add_frame(&frames[i], in, out, &pages, &n_pages);
+        fclose(in);
+        if (err)
+            goto write_err;
+
+        total_size += frames[i].size;
+    }
+
+    // Frame directory followed by the page tables
+    uint64_t dir_offset   = PACK_HEADER_SIZE + (uint64_t)n_pages * PACK_PAGE_SIZE;
+    uint64_t table_offset = dir_offset + (uint64_t)n_in * PACK_DIR_ENTRY_SIZE;
+
+    for (int i = 0; i < n_in; i++) {
+        uint8_t entry[PACK_DIR_ENTRY_SIZE] = { 0 };
+
+        pack_put64(&entry[0], table_offset);
+        pack_put32(&entry[8], frames[i].size);
+        if (fwrite(entry, sizeof(entry), 1, out) != 1)
+            goto write_err;
+
+        table_offset += ((frames[i].size + PACK_PAGE_SIZE - 1) / PACK_PAGE_SIZE) * sizeof(uint32_t);
+    }
+    for (int i = 0; i < n_in; i++) {
+        size_t n_entries = (frames[i].size + PACK_PAGE_SIZE - 1) / PACK_PAGE_SIZE;
+
+        for (size_t j = 0; j < n_entries; j++) {
+            uint8_t index[4];
+
+            pack_put32(index, frames[i].table[j]);
+            if (fwrite(index, sizeof(index), 1, out) != 1)
+                goto write_err;
+        }
+    }
+
+    memcpy(header, PACK_MAGIC, sizeof(PACK_MAGIC));
+    pack_put32(&header[8], PACK_VERSION);
+    pack_put32(&header[12], PACK_PAGE_SIZE);
+    pack_put32(&header[16], n_in);
+    pack_put32(&header[20], n_pages);
+    pack_put64(&header[24], dir_offset);
+    if (fseek(out, 0, SEEK_SET) != 0 || fwrite(header, sizeof(header), 1, out) != 1)
+        goto write_err;
+
+    printf("Packed %d frames, 0x%llX bytes of RDRAM into %u pages (0x%llX bytes)\n", n_in,
+           (unsigned long long)total_size, n_pages, (unsigned long long)n_pages * PACK_PAGE_SIZE);
+    ret = 0;
+    goto done;
+
+write_err:
+    printf("Failed writing %s.\n", out_path);
+done:
+    if (out != NULL)
+        fclose(out);
+    if (frames != NULL) {
+        for (int i = 0; i < n_in; i++)
+            free(frames[i].table);
+        free(frames);
+    }
+    hashmap_destroy(&pages);
+    return ret;
+}
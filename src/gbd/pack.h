@@ -0,0 +1,68 @@
+#ifndef PACK_H_
+#define PACK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ *  Deduplicated multi-frame RDRAM container ("pack")
+ *
+ *  RDRAM snapshots are split into 4KB pages, each distinct page is stored once and every frame is described by a
+ *  table of page indices. All integers are little-endian.
+ *
+ *  0x0000  header (padded to a full page)
+ *              char[8] magic ("GBDPACK\0")
+ *              u32     version
+ *              u32     page size
+ *              u32     number of frames
+ *              u32     number of pages
+ *              u64     offset of the frame directory
+ *  0x1000  pages, page i is at 0x1000 + i * page size
+ *  ...     frame directory, for each frame:
+ *              u64     offset of the frame's page table
+ *              u32     RDRAM size in bytes
+ *              u32     reserved (0)
+ *  ...     page tables, one u32 page index for each page of RDRAM
+ */
+
+#define PACK_MAGIC          "GBDPACK"
+#define PACK_VERSION        1
+#define PACK_PAGE_SIZE      0x1000
+#define PACK_HEADER_SIZE    0x1000
+#define PACK_DIR_ENTRY_SIZE 16
+
+static inline uint32_t
+pack_get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+pack_get64(const uint8_t *p)
+{
+    return pack_get32(p) | ((uint64_t)pack_get32(p + 4) << 32);
+}
+
+static inline void
+pack_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 0;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static inline void
+pack_put64(uint8_t *p, uint64_t v)
+{
+    pack_put32(p, v);
+    pack_put32(p + 4, v >> 32);
+}
+
+bool
+pack_file_detect(const char *path);
+
+int
+pack_write(const char *out_path, char **in_paths, int n_in);
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libgbd/rdram.h"
+
+/**
+ *  RDRAM Buffer Implementation
+ *
+ *  Reads from an RDRAM image that is already in memory.
+ */
+
+static const uint8_t *rdram_buffer_data;
+static size_t         rdram_buffer_size;
+static size_t         rdram_buffer_cur;
+
+static int
+rdram_buffer_close(void)
+{
+    rdram_buffer_data = NULL;
+    rdram_buffer_size = 0;
+    return 0;
+}
+
+static int
+rdram_buffer_open(const void *arg)
+{
+    const rdram_buffer_arg_t *buf_arg = arg;
+
+    if (buf_arg == NULL || buf_arg->data == NULL)
+        return -1;
+
+    rdram_buffer_data = buf_arg->data;
+    rdram_buffer_size = buf_arg->size;
+    rdram_buffer_cur  = 0;
+    return 0;
+}
+
+static long
+rdram_buffer_pos(void)
+{
+    return rdram_buffer_cur;
+}
+
+static bool
+rdram_buffer_addr_valid(uint32_t addr)
+{
+    return addr < rdram_buffer_size;
+}
+
+static size_t
+rdram_buffer_read(void *buf, size_t elem_size, size_t elem_count)
+{
+    if (elem_size == 0 || rdram_buffer_cur >= rdram_buffer_size)
+        return 0;
+
+    size_t n = (rdram_buffer_size - rdram_buffer_cur) / elem_size;
+    if (n > elem_count)
+        n = elem_count;
+
+    memcpy(buf, &rdram_buffer_data[rdram_buffer_cur], n * elem_size);
+    rdram_buffer_cur += n * elem_size;
+    return n;
+}
+
+/**
+ * Returns true if seek to `addr` was successful.
+ */
+static bool
+rdram_buffer_seek(uint32_t addr)
+{
+    if (!rdram_buffer_addr_valid(addr))
+        return false;
+    rdram_buffer_cur = addr;
+    return true;
+}
+
+/**
+ * Returns true if read of `size` bytes at `addr` was successful.
+ */
+static bool
+rdram_buffer_read_at(void *buf, uint32_t addr, size_t size)
+{
+    if (addr > rdram_buffer_size || size > rdram_buffer_size - addr)
+        return false;
+
+    memcpy(buf, &rdram_buffer_data[addr], size);
+    rdram_buffer_cur = addr + size;
+    return true;
+}
+
+/**
+ *  RDRAM Buffer Interface
+ */
+
+rdram_interface_t rdram_interface_buffer = {
+    rdram_buffer_close, rdram_buffer_open, rdram_buffer_pos,     rdram_buffer_addr_valid,
+    rdram_buffer_read,  rdram_buffer_seek, rdram_buffer_read_at, NULL,
+};
@@ -0,0 +1,191 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libgbd/rdram.h"
+
+/**
+ *  RDRAM Cache Implementation
+ *
+ *  Wraps another RDRAM interface with a 4-way set-associative cache of 4KB pages, so small scattered and repeated
+ *  reads (matrices, viewports, lights, palettes) only reach the wrapped interface once per page. Pages that cannot be
+ *  read whole, at the end of the image or next to a hole, are not cached and reads touching them go straight through.
+ */
+
+#define RDRAM_CACHE_PAGE_SIZE 0x1000
+#define RDRAM_CACHE_WAYS      4
+#define RDRAM_CACHE_SETS      64 // 256 pages, 1MB
+
+#define PAGE_NONE UINT32_MAX
+
+typedef struct {
+    uint32_t page[RDRAM_CACHE_WAYS]; // page number held in each way, PAGE_NONE if empty
+    uint32_t used[RDRAM_CACHE_WAYS]; // time of last use, for LRU replacement
+    bool     whole[RDRAM_CACHE_WAYS]; // false if the page could not be read whole, so is not cached
+    uint8_t  data[RDRAM_CACHE_WAYS][RDRAM_CACHE_PAGE_SIZE];
+} RdramCacheSet;
+
+static rdram_interface_t  *rdram_cache_inner;
+static RdramCacheSet       rdram_cache_sets[RDRAM_CACHE_SETS];
+static uint32_t            rdram_cache_clock;
+static uint32_t            rdram_cache_cur;
+static rdram_cache_stats_t rdram_cache_counters;
+
+static int
+rdram_cache_close(void)
+{
+    return rdram_cache_inner->close();
+}
+
+static int
+rdram_cache_open(const void *arg)
+{
+    const rdram_cache_arg_t *cache_arg = arg;
+
+    rdram_cache_inner = cache_arg->inner;
+    rdram_cache_cur   = 0;
+    rdram_cache_clock = 0;
+    memset(&rdram_cache_counters, 0, sizeof(rdram_cache_counters));
+    for (size_t i = 0; i < RDRAM_CACHE_SETS; i++) {
+        for (size_t j = 0; j < RDRAM_CACHE_WAYS; j++)
+            rdram_cache_sets[i].page[j] = PAGE_NONE;
+    }
+    return rdram_cache_inner->open(cache_arg->inner_arg);
+}
+
+static long
+rdram_cache_pos(void)
+{
+    return rdram_cache_cur;
+}
+
+static bool
+rdram_cache_addr_valid(uint32_t addr)
+{
+    return rdram_cache_inner->addr_valid(addr);
+}
+
+static bool
+rdram_cache_range_valid(uint32_t addr, size_t size)
+{
+    if (rdram_cache_inner->range_valid != NULL)
+        return rdram_cache_inner->range_valid(addr, size);
+    return rdram_cache_inner->addr_valid(addr + size);
+}
+
+/**
+ * Returns the cached contents of `page`, loading it if necessary, or NULL if it cannot be read whole.
+ */
+static const uint8_t *
+rdram_cache_page(uint32_t page)
+{
+    RdramCacheSet *set    = &rdram_cache_sets[page % RDRAM_CACHE_SETS];
+    size_t         victim = 0;
+
+    rdram_cache_clock++;
+
+    for (size_t i = 0; i < RDRAM_CACHE_WAYS; i++) {
+        if (set->page[i] == page) {
+            set->used[i] = rdram_cache_clock;
+            if (!set->whole[i])
+                return NULL;
+            rdram_cache_counters.hits++;
+            return set->data[i];
+        }
+        if (set->page[i] == PAGE_NONE || (set->page[victim] != PAGE_NONE && set->used[i] < set->used[victim]))
+            victim = i;
+    }
+
+    rdram_cache_counters.misses++;
+    set->page[victim]  = page;
+    set->used[victim]  = rdram_cache_clock;
+    set->whole[victim] =
+        rdram_cache_inner->read_at(set->data[victim], page * RDRAM_CACHE_PAGE_SIZE, RDRAM_CACHE_PAGE_SIZE);
+    return set->whole[victim] ? set->data[victim] : NULL;
+}
+
+/**
+ * Copies `size` bytes at `addr` into `buf` from the cache, returns false if any of it could not be read.
+ */
+static bool
+rdram_cache_copy(void *buf, uint32_t addr, size_t size)
+{
+    uint8_t *out = buf;
+
+    while (size != 0) {
+        uint32_t       offset = addr % RDRAM_CACHE_PAGE_SIZE;
+        size_t         n      = RDRAM_CACHE_PAGE_SIZE - offset;
+        const uint8_t *page   = rdram_cache_page(addr / RDRAM_CACHE_PAGE_SIZE);
+
+        if (n > size)
+            n = size;
+
+        if (page != NULL) {
+            memcpy(out, &page[offset], n);
+        } else {
+            rdram_cache_counters.bypassed++;
+            if (!rdram_cache_inner->read_at(out, addr, n))
+                return false;
+        }
+        out += n;
+        addr += n;
+        size -= n;
+    }
+    return true;
+}
+
+static size_t
+rdram_cache_read(void *buf, size_t elem_size, size_t elem_count)
+{
+    size_t n;
+
+    // Read whole elements until one fails, like fread
+    for (n = 0; n < elem_count; n++) {
+        if (!rdram_cache_copy((uint8_t *)buf + n * elem_size, rdram_cache_cur, elem_size))
+            break;
+        rdram_cache_cur += elem_size;
+    }
+    return n;
+}
+
+/**
+ * Returns true if seek to `addr` was successful.
+ */
+static bool
+rdram_cache_seek(uint32_t addr)
+{
+    if (!rdram_cache_addr_valid(addr))
+        return false;
+    rdram_cache_cur = addr;
+    return true;
+}
+
+/**
+ * Returns true if read of `size` bytes at `addr` was successful.
+ */
+static bool
+rdram_cache_read_at(void *buf, uint32_t addr, size_t size)
+{
+    if (!rdram_cache_copy(buf, addr, size))
+        return false;
+    rdram_cache_cur = addr + size;
+    return true;
+}
+
+/**
+ * Counters for the most recent use of rdram_interface_cache, valid until it is next opened.
+ */
+void
+rdram_cache_stats(rdram_cache_stats_t *stats)
+{
+    *stats = rdram_cache_counters;
+}
+
+/**
+ *  RDRAM Cache Interface
+ */
+
+rdram_interface_t rdram_interface_cache = {
+    rdram_cache_close, rdram_cache_open, rdram_cache_pos,     rdram_cache_addr_valid,
+    rdram_cache_read,  rdram_cache_seek, rdram_cache_read_at, rdram_cache_range_valid,
+};
@@ -0,0 +1,855 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef GBD_ZLIB
+#    include <zlib.h>
+#endif
+#ifdef GBD_ZSTD
+#    include <zstd.h>
+#endif
+
+#include "libgbd/rdram.h"
+#include "pack.h"
+#include "rdram_compressed.h"
+#include "../libgbd/xxhash.h"
+
+/**
+ *  RDRAM Compressed Implementation
+ *
+ *  Reads gzip or zstd compressed RDRAM dumps without decompressing the whole image. The uncompressed image is divided
+ *  into fixed-size chunks that are decompressed on demand and kept in a small LRU cache. Decompression starts from
+ *  the nearest access point before the requested chunk: for gzip these are deflate block boundaries saved along with
+ *  the preceding 32KB window (as in zlib's zran example), for zstd they are the starts of independent frames.
+ *
+ *  Access points are found by decompressing the file once, they are then saved to a sidecar index file next to the
+ *  dump (<dump>.gbdidx) so that later runs can skip this step. The index records the size, modification time and hash
+ *  of the compressed file and is rebuilt if any of them no longer match. zstd files in the seekable format list their
+ *  frames in a seek table at the end of the file, which is used instead.
+ *
+ *  zstd has no way to resume decompression in the middle of a frame, so a dump compressed as a single frame only has
+ *  the one access point at its start. To avoid decompressing from the start on every cache miss the zstd decoder is
+ *  kept where it stopped, misses further into the same frame continue from there.
+ */
+
+#define CZ_CHUNK_SIZE  0x10000 // size of a cached chunk of uncompressed data
+#define CZ_SPAN        0x80000 // minimum uncompressed distance between gzip access points
+#define CZ_WINDOW_SIZE 0x8000  // deflate window size
+#define CZ_CACHE_SIZE  32      // number of chunks kept in the cache
+#define CZ_IN_SIZE     0x4000  // size of compressed reads
+
+#define CZ_INDEX_MAGIC   "GBDZIDX"
+#define CZ_INDEX_VERSION 2
+#define CZ_INDEX_HEADER  48
+
+#define CZ_SEEKABLE_MAGIC       0x8F92EAB1 // zstd seekable format seek table footer
+#define CZ_SEEKABLE_FOOTER_SIZE 9
+#define CZ_SKIPPABLE_HEADER     8
+
+enum cz_type {
+    CZ_NONE,
+    CZ_GZIP,
+    CZ_ZSTD,
+};
+
+typedef struct {
+    uint64_t out;    // uncompressed offset
+    uint64_t in;     // compressed offset
+    int      bits;   // gzip: number of bits of the byte before `in` that belong to the block, 0 if byte-aligned
+    uint8_t *window; // gzip: the CZ_WINDOW_SIZE bytes of uncompressed data before `out`, NULL for zstd
+} CzPoint;
+
+typedef struct {
+    int64_t  chunk; // chunk number, -1 if unused
+    uint64_t last_use;
+    size_t   size; // may be less than CZ_CHUNK_SIZE for the final chunk
+    uint8_t *data;
+} CzCacheEntry;
+
+static struct {
+    FILE        *file;
+    enum cz_type type;
+    uint64_t     in_size;  // compressed size
+    uint64_t     in_mtime; // modification time of the compressed file
+    uint64_t     in_hash;  // hash of the compressed file, to tell whether an index belongs to it
+    uint64_t     out_size; // uncompressed size
+    CzPoint     *points;
+    uint32_t     n_points;
+    CzCacheEntry cache[CZ_CACHE_SIZE];
+    uint64_t     use_counter;
+    uint32_t     cur;
+#ifdef GBD_ZSTD
+    ZSTD_DCtx        *zstd;
+    struct CzZstdCtx *zstd_ctx; // decoder state kept between chunk decompressions
+#endif
+} cz;
+
+static enum cz_type
+cz_detect_type(FILE *f)
+{
+    uint8_t magic[4];
+
+    if (fseek(f, 0, SEEK_SET) != 0 || fread(magic, sizeof(magic), 1, f) != 1)
+        return CZ_NONE;
+#ifdef GBD_ZLIB
+    if (magic[0] == 0x1F && magic[1] == 0x8B)
+        return CZ_GZIP;
+#endif
+#ifdef GBD_ZSTD
+    if (magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD)
+        return CZ_ZSTD;
+#endif
+    return CZ_NONE;
+}
+
+bool
+rdram_compressed_detect(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL)
+        return false;
+
+    bool compressed = cz_detect_type(f) != CZ_NONE;
+    fclose(f);
+    return compressed;
+}
+
+static bool
+cz_add_point(uint64_t out, uint64_t in, int bits, const uint8_t *window, size_t window_left)
+{
+    if ((cz.n_points & (cz.n_points - 1)) == 0) {
+        // grow when the count reaches a power of 2
+        CzPoint *resize = realloc(cz.points, (cz.n_points ? cz.n_points * 2 : 8) * sizeof(CzPoint));
+        if (resize == NULL)
+            return false;
+        cz.points = resize;
+    }
+
+    CzPoint *point = &cz.points[cz.n_points++];
+    point->out     = out;
+    point->in      = in;
+    point->bits    = bits;
+    point->window  = NULL;
+
+    if (window != NULL) {
+        point->window = malloc(CZ_WINDOW_SIZE);
+        if (point->window == NULL)
+            return false;
+        // The window is circular, `window_left` bytes at the end are the oldest
+        memcpy(point->window, &window[CZ_WINDOW_SIZE - window_left], window_left);
+        memcpy(&point->window[window_left], window, CZ_WINDOW_SIZE - window_left);
+    }
+    return true;
+}
+
+static void
+cz_free_points(void)
+{
+    for (uint32_t i = 0; i < cz.n_points; i++)
+        free(cz.points[i].window);
+    free(cz.points);
+    cz.points   = NULL;
+    cz.n_points = 0;
+}
+
+/**************************************************************************
+ *  Index building
+ */
+
+#ifdef GBD_ZLIB
+static bool
+cz_gzip_build_index(void)
+{
+    uint8_t  in_buf[CZ_IN_SIZE];
+    uint8_t  window[CZ_WINDOW_SIZE] = { 0 };
+    uint64_t tot_in                 = 0;
+    uint64_t tot_out                = 0;
+    uint64_t last                   = 0;
+    bool     ok                     = false;
+    int      ret                    = Z_OK;
+    z_stream strm                   = { 0 };
+
+    if (inflateInit2(&strm, 47) != Z_OK) // 47: detect gzip or zlib header, 32KB window
+        return false;
+
+    fseek(cz.file, 0, SEEK_SET);
+    do {
+        strm.avail_in = fread(in_buf, 1, sizeof(in_buf), cz.file);
+        if (strm.avail_in == 0)
+            goto done; // truncated
+        strm.next_in = in_buf;
+
+        do {
+            if (strm.avail_out == 0) {
+                strm.avail_out = sizeof(window);
+                strm.next_out  = window;
+            }
+
+            tot_in += strm.avail_in;
+            tot_out += strm.avail_out;
+            ret = inflate(&strm, Z_BLOCK);
+            tot_in -= strm.avail_in;
+            tot_out -= strm.avail_out;
+
+            if (ret == Z_NEED_DICT || ret == Z_MEM_ERROR || ret == Z_DATA_ERROR)
+                goto done;
+            if (ret == Z_STREAM_END)
+                break;
+
+            // At the end of a deflate block that is not the last, record an access point if far enough from the last
+            if ((strm.data_type & 128) && !(strm.data_type & 64) && (tot_out == 0 || tot_out - last > CZ_SPAN)) {
+                if (!cz_add_point(tot_out, tot_in, strm.data_type & 7, (tot_out != 0) ? window : NULL,
+                                  strm.avail_out))
+                    goto done;
+                last = tot_out;
+            }
+        } while (strm.avail_in != 0);
+    } while (ret != Z_STREAM_END);
+
+    cz.out_size = tot_out;
+    ok          = true;
+done:
+    inflateEnd(&strm);
+    return ok;
+}
+#endif
+
+#ifdef GBD_ZSTD
+/**
+ * Reads the access points from the seek table of a file in the zstd seekable format. Returns false if there is no
+ * seek table.
+ */
+static bool
+cz_zstd_read_seek_table(void)
+{
+    uint8_t footer[CZ_SEEKABLE_FOOTER_SIZE];
+
+    if (cz.in_size < CZ_SKIPPABLE_HEADER + CZ_SEEKABLE_FOOTER_SIZE ||
+        fseek(cz.file, cz.in_size - CZ_SEEKABLE_FOOTER_SIZE, SEEK_SET) != 0 ||
+        fread(footer, sizeof(footer), 1, cz.file) != 1 || pack_get32(&footer[5]) != CZ_SEEKABLE_MAGIC)
+        return false;
+
+    uint32_t n_frames   = pack_get32(&footer[0]);
+    size_t   entry_size = (footer[4] & 0x80) ? 12 : 8; // entries include a checksum if bit 7 of the descriptor is set
+    uint64_t table_size = (uint64_t)n_frames * entry_size;
+    uint64_t in         = 0;
+    uint64_t out        = 0;
+
+    if (n_frames == 0 || table_size > cz.in_size - CZ_SKIPPABLE_HEADER - CZ_SEEKABLE_FOOTER_SIZE ||
+        fseek(cz.file, cz.in_size - CZ_SEEKABLE_FOOTER_SIZE - table_size, SEEK_SET) != 0)
+        return false;
+
+    for (uint32_t i = 0; i < n_frames; i++) {
+        uint8_t entry[12];
+
+        if (fread(entry, entry_size, 1, cz.file) != 1 || !cz_add_point(out, in, 0, NULL, 0)) {
+            cz_free_points();
+            return false;
+        }
+        in += pack_get32(&entry[0]);
+        out += pack_get32(&entry[4]);
+    }
+    cz.out_size = out;
+    return true;
+}
+
+static bool
+cz_zstd_build_index(void)
+{
+    uint8_t  in_buf[CZ_IN_SIZE];
+    uint8_t  out_buf[CZ_CHUNK_SIZE];
+    uint64_t tot_in  = 0;
+    uint64_t tot_out = 0;
+    size_t   ret     = 0;
+
+    if (cz_zstd_read_seek_table())
+        return true;
+
+    ZSTD_DCtx_reset(cz.zstd, ZSTD_reset_session_only);
+    fseek(cz.file, 0, SEEK_SET);
+
+    // Every frame can be decompressed independently
+    if (!cz_add_point(0, 0, 0, NULL, 0))
+        return false;
+
+    size_t n_in;
+    while ((n_in = fread(in_buf, 1, sizeof(in_buf), cz.file)) != 0) {
+        ZSTD_inBuffer input = { in_buf, n_in, 0 };
+
+        while (input.pos < input.size) {
+            ZSTD_outBuffer output = { out_buf, sizeof(out_buf), 0 };
+            size_t         start  = input.pos;
+
+            ret = ZSTD_decompressStream(cz.zstd, &output, &input);
+            if (ZSTD_isError(ret))
+                return false;
+
+            tot_in += input.pos - start;
+            tot_out += output.pos;
+
+            if (ret == 0 && (input.pos < input.size || tot_in < cz.in_size)) {
+                // frame boundary
+                if (!cz_add_point(tot_out, tot_in, 0, NULL, 0))
+                    return false;
+            }
+        }
+    }
+    if (ret != 0)
+        return false; // truncated
+
+    cz.out_size = tot_out;
+    return true;
+}
+#endif
+
+/**************************************************************************
+ *  Sidecar index
+ */
+
+static char *
+cz_index_path(const char *path)
+{
+    size_t len      = strlen(path);
+    char  *idx_path = malloc(len + sizeof(".gbdidx"));
+
+    if (idx_path != NULL) {
+        memcpy(idx_path, path, len);
+        memcpy(&idx_path[len], ".gbdidx", sizeof(".gbdidx"));
+    }
+    return idx_path;
+}
+
+/**
+ * Hashes the whole compressed file, an index is only reused for the exact file it was built from.
+ */
+static bool
+cz_hash_input(void)
+{
+    uint8_t buf[CZ_IN_SIZE];
+    size_t  n;
+
+    cz.in_hash = 0;
+    if (fseek(cz.file, 0, SEEK_SET) != 0)
+        return false;
+    while ((n = fread(buf, 1, sizeof(buf), cz.file)) != 0)
+        cz.in_hash = xxh64(buf, n, cz.in_hash);
+    return !ferror(cz.file);
+}
+
+/**
+ * Loads the index from the sidecar file if it exists and matches the dump.
+ */
+static bool
+cz_load_index(const char *idx_path)
+{
+    uint8_t header[CZ_INDEX_HEADER];
+    FILE   *f = fopen(idx_path, "rb");
+
+    if (f == NULL)
+        return false;
+
+    if (fread(header, sizeof(header), 1, f) != 1 || memcmp(header, CZ_INDEX_MAGIC, sizeof(CZ_INDEX_MAGIC)) != 0 ||
+        pack_get32(&header[8]) != CZ_INDEX_VERSION || pack_get32(&header[12]) != cz.type ||
+        pack_get64(&header[16]) != cz.in_size || pack_get64(&header[32]) != cz.in_mtime ||
+        pack_get64(&header[40]) != cz.in_hash)
+        goto err; // not an index for this file
+
+    cz.out_size = pack_get64(&header[24]);
+
+    for (;;) {
+        uint8_t entry[24];
+        size_t  n = fread(entry, 1, sizeof(entry), f);
+
+        if (n == 0)
+            break;
+        if (n != sizeof(entry))
+            goto err;
+
+        bool has_window = pack_get32(&entry[20]) != 0;
+        if (!cz_add_point(pack_get64(&entry[0]), pack_get64(&entry[8]), pack_get32(&entry[16]), NULL, 0))
+            goto err;
+
+        if (has_window) {
+            CzPoint *point = &cz.points[cz.n_points - 1];
+
+            point->window = malloc(CZ_WINDOW_SIZE);
+            if (point->window == NULL || fread(point->window, CZ_WINDOW_SIZE, 1, f) != 1)
+                goto err;
+        }
+    }
+    fclose(f);
+    return cz.n_points != 0;
+err:
+    fclose(f);
+    cz_free_points();
+    return false;
+}
+
+/**
+ * Saves the index to the sidecar file, failure is not an error as the index can always be rebuilt.
+ */
+static void
+cz_save_index(const char *idx_path)
+{
+    uint8_t header[CZ_INDEX_HEADER] = { 0 };
+    FILE   *f                       = fopen(idx_path, "wb");
+
+    if (f == NULL)
+        return;
+
+    memcpy(header, CZ_INDEX_MAGIC, sizeof(CZ_INDEX_MAGIC));
+    pack_put32(&header[8], CZ_INDEX_VERSION);
+    pack_put32(&header[12], cz.type);
+    pack_put64(&header[16], cz.in_size);
+    pack_put64(&header[24], cz.out_size);
+    pack_put64(&header[32], cz.in_mtime);
+    pack_put64(&header[40], cz.in_hash);
+    bool ok = fwrite(header, sizeof(header), 1, f) == 1;
+
+    for (uint32_t i = 0; ok && i < cz.n_points; i++) {
+        uint8_t entry[24];
+
+        pack_put64(&entry[0], cz.points[i].out);
+        pack_put64(&entry[8], cz.points[i].in);
+        pack_put32(&entry[16], cz.points[i].bits);
+        pack_put32(&entry[20], cz.points[i].window != NULL);
+        ok = fwrite(entry, sizeof(entry), 1, f) == 1 &&
+             (cz.points[i].window == NULL || fwrite(cz.points[i].window, CZ_WINDOW_SIZE, 1, f) == 1);
+    }
+    fclose(f);
+
+    if (!ok)
+        remove(idx_path);
+}
+
+/**************************************************************************
+ *  Chunk decompression
+ */
+
+/**
+ * Fills `out` with up to `size` bytes of uncompressed data from the decompressor state set up by the caller. Returns
+ * the number of bytes produced, less than `size` only at the end of the data, or -1 on error.
+ */
+typedef long (*cz_decode_fn)(void *ctx, uint8_t *out, size_t size);
+
+#ifdef GBD_ZLIB
+typedef struct {
+    z_stream strm;
+    uint8_t  in_buf[CZ_IN_SIZE];
+} CzGzipCtx;
+
+static long
+cz_gzip_decode(void *ctx, uint8_t *out, size_t size)
+{
+    CzGzipCtx *gz = ctx;
+
+    gz->strm.next_out  = out;
+    gz->strm.avail_out = size;
+
+    while (gz->strm.avail_out != 0) {
+        if (gz->strm.avail_in == 0) {
+            gz->strm.avail_in = fread(gz->in_buf, 1, sizeof(gz->in_buf), cz.file);
+            gz->strm.next_in  = gz->in_buf;
+            if (gz->strm.avail_in == 0)
+                return -1;
+        }
+
+        int ret = inflate(&gz->strm, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END)
+            break;
+        if (ret != Z_OK)
+            return -1;
+    }
+    return size - gz->strm.avail_out;
+}
+#endif
+
+#ifdef GBD_ZSTD
+typedef struct CzZstdCtx {
+    ZSTD_inBuffer input;
+    uint8_t       in_buf[CZ_IN_SIZE];
+    bool          valid;   // whether the decoder can be resumed
+    uint64_t      out;     // uncompressed offset the decoder stopped at
+    long          in_next; // file offset of the compressed data after `in_buf`
+} CzZstdCtx;
+
+static long
+cz_zstd_decode(void *ctx, uint8_t *out, size_t size)
+{
+    CzZstdCtx     *zs     = ctx;
+    ZSTD_outBuffer output = { out, size, 0 };
+
+    while (output.pos < output.size) {
+        if (zs->input.pos == zs->input.size) {
+            zs->input.size = fread(zs->in_buf, 1, sizeof(zs->in_buf), cz.file);
+            zs->input.pos  = 0;
+            if (zs->input.size == 0)
+                break; // end of data
+        }
+
+        size_t ret = ZSTD_decompressStream(cz.zstd, &output, &zs->input);
+        if (ZSTD_isError(ret))
+            return -1;
+    }
+    return output.pos;
+}
+#endif
+
+static CzCacheEntry *
+cz_cache_find(int64_t chunk)
+{
+    for (int i = 0; i < CZ_CACHE_SIZE; i++) {
+        if (cz.cache[i].chunk == chunk)
+            return &cz.cache[i];
+    }
+    return NULL;
+}
+
+static CzCacheEntry *
+cz_cache_evict(void)
+{
+    CzCacheEntry *lru = &cz.cache[0];
+
+    for (int i = 1; i < CZ_CACHE_SIZE; i++) {
+        if (cz.cache[i].last_use < lru->last_use)
+            lru = &cz.cache[i];
+    }
+    lru->chunk = -1;
+    return lru;
+}
+
+/**
+ * Decompresses from the last access point at or before `chunk` up to and including `chunk`. Every whole chunk that is
+ * decompressed along the way is also added to the cache.
+ */
+static CzCacheEntry *
+cz_decompress_chunk(int64_t chunk)
+{
+    uint64_t      chunk_start = (uint64_t)chunk * CZ_CHUNK_SIZE;
+    uint32_t      lo          = 0;
+    uint32_t      hi          = cz.n_points;
+    CzCacheEntry *target      = NULL;
+    void         *ctx;
+    cz_decode_fn  decode;
+
+    // Binary search for the last point at or before the chunk
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+
+        if (cz.points[mid].out <= chunk_start)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    CzPoint *point = &cz.points[lo];
+    uint64_t pos   = point->out;
+
+    if (fseek(cz.file, point->in - (point->bits != 0), SEEK_SET) != 0)
+        return NULL;
+
+    switch (cz.type) {
+#ifdef GBD_ZLIB
+        case CZ_GZIP:
+            {
+                CzGzipCtx *gz = calloc(1, sizeof(CzGzipCtx));
+                if (gz == NULL)
+                    return NULL;
+
+                if (point->window == NULL) {
+                    // The first point is at the very start of the file, before the gzip header
+                    fseek(cz.file, 0, SEEK_SET);
+                    inflateInit2(&gz->strm, 47);
+                } else {
+                    inflateInit2(&gz->strm, -15); // raw deflate
+                    if (point->bits != 0) {
+                        int c = getc(cz.file);
+                        inflatePrime(&gz->strm, point->bits, c >> (8 - point->bits));
+                    }
+                    inflateSetDictionary(&gz->strm, point->window, CZ_WINDOW_SIZE);
+                }
+                ctx    = gz;
+                decode = cz_gzip_decode;
+            }
+            break;
+#endif
+#ifdef GBD_ZSTD
+        case CZ_ZSTD:
+            {
+                CzZstdCtx *zs = cz.zstd_ctx;
+
+                if (zs->valid && zs->out >= point->out && zs->out <= chunk_start) {
+                    // Continue from where the last decompression stopped, it is in the same frame and closer
+                    if (fseek(cz.file, zs->in_next, SEEK_SET) != 0)
+                        return NULL;
+                    pos = zs->out;
+                } else {
+                    ZSTD_DCtx_reset(cz.zstd, ZSTD_reset_session_only);
+                    zs->input.src  = zs->in_buf;
+                    zs->input.size = 0;
+                    zs->input.pos  = 0;
+                }
+                zs->valid = false;
+                ctx       = zs;
+                decode    = cz_zstd_decode;
+            }
+            break;
+#endif
+        default:
+            return NULL;
+    }
+
+    // Discard data up to the first chunk boundary at or after the access point
+    uint64_t first = (pos + CZ_CHUNK_SIZE - 1) / CZ_CHUNK_SIZE;
+    while (pos < first * CZ_CHUNK_SIZE) {
+        uint8_t discard[0x1000];
+        size_t  n = first * CZ_CHUNK_SIZE - pos;
+        long    got;
+
+        if (n > sizeof(discard))
+            n = sizeof(discard);
+        got = decode(ctx, discard, n);
+        if (got <= 0)
+            goto done;
+        pos += got;
+    }
+
+    for (int64_t c = first; c <= chunk; c++) {
+        CzCacheEntry *ent = cz_cache_find(c);
+        uint8_t       scratch[CZ_CHUNK_SIZE];
+        uint8_t      *dst = scratch;
+
+        if (ent == NULL) {
+            ent = cz_cache_evict();
+            dst = ent->data;
+        }
+
+        long got = decode(ctx, dst, CZ_CHUNK_SIZE);
+        if (got <= 0)
+            goto done;
+
+        if (dst != scratch) {
+            ent->chunk = c;
+            ent->size  = got;
+        }
+        ent->last_use = ++cz.use_counter;
+        pos += got;
+
+        if (c == chunk)
+            target = ent;
+    }
+done:
+    switch (cz.type) {
+#ifdef GBD_ZLIB
+        case CZ_GZIP:
+            inflateEnd(&((CzGzipCtx *)ctx)->strm);
+            free(ctx);
+            break;
+#endif
+#ifdef GBD_ZSTD
+        case CZ_ZSTD:
+            {
+                CzZstdCtx *zs = ctx;
+
+                // Keep the decoder for the next miss
+                zs->in_next = ftell(cz.file);
+                zs->out     = pos;
+                zs->valid   = target != NULL && zs->in_next >= 0;
+            }
+            break;
+#endif
+        default:
+            break;
+    }
+    return target;
+}
+
+static CzCacheEntry *
+cz_get_chunk(int64_t chunk)
+{
+    CzCacheEntry *ent = cz_cache_find(chunk);
+
+    if (ent == NULL)
+        ent = cz_decompress_chunk(chunk);
+    else
+        ent->last_use = ++cz.use_counter;
+    return ent;
+}
+
+/**************************************************************************
+ *  Interface
+ */
+
+static int
+rdram_compressed_close(void)
+{
+    for (int i = 0; i < CZ_CACHE_SIZE; i++) {
+        free(cz.cache[i].data);
+        cz.cache[i].data = NULL;
+    }
+    cz_free_points();
+#ifdef GBD_ZSTD
+    ZSTD_freeDCtx(cz.zstd);
+    cz.zstd = NULL;
+    free(cz.zstd_ctx);
+    cz.zstd_ctx = NULL;
+#endif
+    return (cz.file != NULL) ? fclose(cz.file) : 0;
+}
+
+static int
+rdram_compressed_open(const void *arg)
+{
+    const char *path = arg;
+    struct stat st;
+
+    memset(&cz, 0, sizeof(cz));
+
+    cz.file = fopen(path, "rb");
+    if (cz.file == NULL)
+        return -1;
+
+    if (fstat(fileno(cz.file), &st) != 0)
+        goto err;
+    cz.in_size  = st.st_size;
+    cz.in_mtime = st.st_mtime;
+
+    cz.type = cz_detect_type(cz.file);
+    if (cz.type == CZ_NONE)
+        goto err;
+
+#ifdef GBD_ZSTD
+    cz.zstd     = ZSTD_createDCtx();
+    cz.zstd_ctx = calloc(1, sizeof(*cz.zstd_ctx));
+    if (cz.zstd == NULL || cz.zstd_ctx == NULL)
+        goto err;
+#endif
+
+    for (int i = 0; i < CZ_CACHE_SIZE; i++) {
+        cz.cache[i].chunk = -1;
+        cz.cache[i].data  = malloc(CZ_CHUNK_SIZE);
+        if (cz.cache[i].data == NULL)
+            goto err;
+    }
+
+    char *idx_path = cz_index_path(path);
+    if (idx_path == NULL || !cz_hash_input()) {
+        free(idx_path);
+        goto err;
+    }
+
+    if (!cz_load_index(idx_path)) {
+        bool built = false;
+
+        switch (cz.type) {
+#ifdef GBD_ZLIB
+            case CZ_GZIP:
+                built = cz_gzip_build_index();
+                break;
+#endif
+#ifdef GBD_ZSTD
+            case CZ_ZSTD:
+                built = cz_zstd_build_index();
+                break;
+#endif
+            default:
+                break;
+        }
+        if (!built) {
+            free(idx_path);
+            goto err;
+        }
+        cz_save_index(idx_path);
+    }
+    free(idx_path);
+
+    if (cz.out_size > UINT32_MAX)
+        goto err;
+
+    cz.cur = 0;
+    return 0;
+err:
+    rdram_compressed_close();
+    return -2;
+}
+
+static long
+rdram_compressed_pos(void)
+{
+    return cz.cur;
+}
+
+static bool
+rdram_compressed_addr_valid(uint32_t addr)
+{
+    return addr < cz.out_size;
+}
+
+/**
+ * Returns true if seek to `addr` was successful.
+ */
+static bool
+rdram_compressed_seek(uint32_t addr)
+{
+    if (!rdram_compressed_addr_valid(addr))
+        return false;
+    cz.cur = addr;
+    return true;
+}
+
+/**
+ * Returns true if read of `size` bytes at `addr` was successful.
+ */
+static bool
+rdram_compressed_read_at(void *buf, uint32_t addr, size_t size)
+{
+    uint8_t *out = buf;
+
+    if (addr > cz.out_size || size > cz.out_size - addr)
+        return false;
+
+    cz.cur = addr + size;
+
+    while (size != 0) {
+        CzCacheEntry *ent    = cz_get_chunk(addr / CZ_CHUNK_SIZE);
+        uint32_t      offset = addr % CZ_CHUNK_SIZE;
+
+        if (ent == NULL || offset >= ent->size)
+            return false;
+
+        size_t n = ent->size - offset;
+        if (n > size)
+            n = size;
+        memcpy(out, &ent->data[offset], n);
+
+        out += n;
+        addr += n;
+        size -= n;
+    }
+    return true;
+}
+
+static size_t
+rdram_compressed_read(void *buf, size_t elem_size, size_t elem_count)
+{
+    if (elem_size == 0 || cz.cur >= cz.out_size)
+        return 0;
+
+    size_t n = (cz.out_size - cz.cur) / elem_size;
+    if (n > elem_count)
+        n = elem_count;
+
+    return rdram_compressed_read_at(buf, cz.cur, n * elem_size) ? n : 0;
+}
+
+/**
+ *  RDRAM Compressed Interface
+ */
+
+rdram_interface_t rdram_interface_compressed = {
+    rdram_compressed_close, rdram_compressed_open, rdram_compressed_pos,     rdram_compressed_addr_valid,
+    rdram_compressed_read,  rdram_compressed_seek, rdram_compressed_read_at, NULL,
+};
@@ -0,0 +1,9 @@
+#ifndef RDRAM_COMPRESSED_H_
+#define RDRAM_COMPRESSED_H_
+
+#include <stdbool.h>
+
+bool
+rdram_compressed_detect(const char *path);
+
+#endif
@@ -80,5 +80,5 @@ rdram_file_read_at(void *buf, uint32_t addr, size_t size)
 
 rdram_interface_t rdram_interface_file = {
     rdram_file_close, rdram_file_open, rdram_file_pos,     rdram_file_addr_valid,
-    rdram_file_read,  rdram_file_seek, rdram_file_read_at,
+    rdram_file_read,  rdram_file_seek, rdram_file_read_at, NULL,
 };
@@ -0,0 +1,492 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WINDOWS
+#    include <netdb.h>
+#    include <sys/socket.h>
+#    include <sys/un.h>
+#    include <unistd.h>
+#endif
+
+#include "libgbd/rdram.h"
+
+/**
+ *  RDRAM GDB Remote Implementation
+ *
+ *  Reads RDRAM from a paused emulator through its GDB remote serial protocol stub, over TCP (`<host>:<port>`) or a
+ *  Unix socket (`unix:<path>`). Memory is fetched in 4KB pages that are kept in a direct-mapped cache; runs of
+ *  adjacent missing pages are fetched with a single `m` packet, and sequential reads (walking a display list) also
+ *  fetch the pages that follow. The target is never resumed or detached from.
+ */
+
+#define RDRAM_GDB_SIZE      0x800000   // the stub has no way to report this, assume the expansion pak
+#define RDRAM_GDB_VADDR     0x80000000 // RDRAM is requested through KSEG0
+#define RDRAM_GDB_PAGE_SIZE 0x1000
+#define RDRAM_GDB_PAGES     256 // cache slots, 1MB
+#define RDRAM_GDB_PREFETCH  4   // pages fetched ahead of sequential reads
+#define RDRAM_GDB_MAX_RUN   16  // pages fetched per packet at most
+
+#define RDRAM_GDB_DEFAULT_PACKET_SIZE 0x400
+
+#define PAGE_NONE UINT32_MAX
+
+#ifndef WINDOWS
+
+static int      rdram_gdb_sock = -1;
+static size_t   rdram_gdb_packet_size; // largest packet the stub accepts or sends
+static uint32_t rdram_gdb_cur;
+static char    *rdram_gdb_reply; // receive buffer, holds one reply of up to rdram_gdb_packet_size
+
+static struct {
+    uint8_t buf[0x1000];
+    size_t  len;
+    size_t  pos;
+} rdram_gdb_in; // received bytes not yet consumed
+
+static struct {
+    uint32_t page[RDRAM_GDB_PAGES]; // page number held in each slot, PAGE_NONE if empty
+    uint8_t  data[RDRAM_GDB_PAGES][RDRAM_GDB_PAGE_SIZE];
+} rdram_gdb_cache;
+
+static bool
+rdram_gdb_send_raw(const void *data, size_t size)
+{
+    const char *p = data;
+
+    while (size != 0) {
+        ssize_t n = send(rdram_gdb_sock, p, size, 0);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static int
+rdram_gdb_getc(void)
+{
+    if (rdram_gdb_in.pos == rdram_gdb_in.len) {
+        ssize_t n = recv(rdram_gdb_sock, rdram_gdb_in.buf, sizeof(rdram_gdb_in.buf), 0);
+        if (n <= 0)
+            return -1;
+        rdram_gdb_in.len = n;
+        rdram_gdb_in.pos = 0;
+    }
+    return rdram_gdb_in.buf[rdram_gdb_in.pos++];
+}
+
+static int
+rdram_gdb_hex_digit(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Sends the packet `$<cmd>#<checksum>`, retransmitting until the stub acknowledges it.
+ */
+static bool
+rdram_gdb_send(const char *cmd)
+{
+    char    trailer[4];
+    uint8_t sum = 0;
+
+    for (const char *p = cmd; *p != '\0'; p++)
+        sum += *p;
+    snprintf(trailer, sizeof(trailer), "#%02x", sum);
+
+    for (int tries = 0; tries < 3; tries++) {
+        int c;
+
+        if (!rdram_gdb_send_raw("$", 1) || !rdram_gdb_send_raw(cmd, strlen(cmd)) || !rdram_gdb_send_raw(trailer, 3))
+            return false;
+
+        while ((c = rdram_gdb_getc()) != '+' && c != '-') {
+            if (c < 0)
+                return false;
+        }
+        if (c == '+')
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Receives one reply packet into rdram_gdb_reply, expanding run-length encoding, and acknowledges it. Returns the
+ * length of the reply or -1 on failure.
+ */
+static long
+rdram_gdb_recv(void)
+{
+    while (true) {
+        int     c;
+        size_t  len = 0;
+        uint8_t sum = 0;
+
+        while ((c = rdram_gdb_getc()) != '$') {
+            if (c < 0)
+                return -1;
+        }
+
+        while ((c = rdram_gdb_getc()) != '#') {
+            if (c < 0)
+                return -1;
+            sum += c;
+
+            if (c == '*' && len != 0) {
+                // run-length encoding, the previous character is repeated (next - 29) more times
+                int n = rdram_gdb_getc();
+                if (n < 0)
+                    return -1;
+                sum += n;
+                for (n -= 29; n > 0 && len < rdram_gdb_packet_size; n--, len++)
+                    rdram_gdb_reply[len] = rdram_gdb_reply[len - 1];
+            } else if (len < rdram_gdb_packet_size) {
+                rdram_gdb_reply[len++] = c;
+            }
+        }
+        int hi = rdram_gdb_hex_digit(rdram_gdb_getc());
+        int lo = rdram_gdb_hex_digit(rdram_gdb_getc());
+
+        if (hi >= 0 && lo >= 0 && ((hi << 4) | lo) == sum) {
+            rdram_gdb_reply[len] = '\0';
+            return rdram_gdb_send_raw("+", 1) ? (long)len : -1;
+        }
+        if (!rdram_gdb_send_raw("-", 1))
+            return -1;
+    }
+}
+
+/**
+ * Reads `size` bytes at physical `addr` from the target with as few `m` packets as the packet size allows.
+ */
+static bool
+rdram_gdb_fetch(uint8_t *buf, uint32_t addr, size_t size)
+{
+    // "m<addr>,<len>" replies with two hex digits per byte
+    size_t max_len = (rdram_gdb_packet_size - 4) / 2;
+
+    while (size != 0) {
+        char   cmd[32];
+        size_t len = (size < max_len) ? size : max_len;
+
+        snprintf(cmd, sizeof(cmd), "m%x,%zx", RDRAM_GDB_VADDR + addr, len);
+        if (!rdram_gdb_send(cmd))
+            return false;
+
+        long reply_len = rdram_gdb_recv();
+        if (reply_len < 2)
+            return false;
+        // Errors are exactly "E" and two hex digits, longer replies starting with 'E' are memory starting with 0xEx
+        if (reply_len == 3 && rdram_gdb_reply[0] == 'E' && rdram_gdb_hex_digit(rdram_gdb_reply[1]) >= 0 &&
+            rdram_gdb_hex_digit(rdram_gdb_reply[2]) >= 0)
+            return false;
+
+        // The stub may return fewer bytes than asked for
+        size_t got = reply_len / 2;
+        if (got > len)
+            got = len;
+        for (size_t i = 0; i < got; i++) {
+            int hi = rdram_gdb_hex_digit(rdram_gdb_reply[2 * i + 0]);
+            int lo = rdram_gdb_hex_digit(rdram_gdb_reply[2 * i + 1]);
+
+            if (hi < 0 || lo < 0)
+                return false;
+            buf[i] = (hi << 4) | lo;
+        }
+        buf += got;
+        addr += got;
+        size -= got;
+    }
+    return true;
+}
+
+static inline bool
+rdram_gdb_cached(uint32_t page)
+{
+    return rdram_gdb_cache.page[page % RDRAM_GDB_PAGES] == page;
+}
+
+/**
+ * Makes pages [first, last] resident, fetching each run of adjacent missing pages with one request.
+ */
+static bool
+rdram_gdb_load_pages(uint32_t first, uint32_t last)
+{
+    static uint8_t run_buf[RDRAM_GDB_MAX_RUN * RDRAM_GDB_PAGE_SIZE];
+
+    for (uint32_t page = first; page <= last;) {
+        if (rdram_gdb_cached(page)) {
+            page++;
+            continue;
+        }
+
+        uint32_t run = 1;
+        while (run < RDRAM_GDB_MAX_RUN && page + run <= last && !rdram_gdb_cached(page + run))
+            run++;
+
+        if (!rdram_gdb_fetch(run_buf, page * RDRAM_GDB_PAGE_SIZE, run * RDRAM_GDB_PAGE_SIZE))
+            return false;
+
+        for (uint32_t i = 0; i < run; i++) {
+            uint32_t slot = (page + i) % RDRAM_GDB_PAGES;
+
+            rdram_gdb_cache.page[slot] = page + i;
+            memcpy(rdram_gdb_cache.data[slot], &run_buf[i * RDRAM_GDB_PAGE_SIZE], RDRAM_GDB_PAGE_SIZE);
+        }
+        page += run;
+    }
+    return true;
+}
+
+/**
+ * Copies `size` bytes at `addr` into `buf` through the page cache, also loading `prefetch` pages past the end.
+ */
+static bool
+rdram_gdb_copy(void *buf, uint32_t addr, size_t size, uint32_t prefetch)
+{
+    if (addr >= RDRAM_GDB_SIZE || size > RDRAM_GDB_SIZE - addr)
+        return false;
+    if (size == 0)
+        return true;
+
+    uint32_t first = addr / RDRAM_GDB_PAGE_SIZE;
+    uint32_t last  = (addr + size - 1) / RDRAM_GDB_PAGE_SIZE;
+    uint32_t end   = last + prefetch;
+
+    if (end >= RDRAM_GDB_SIZE / RDRAM_GDB_PAGE_SIZE)
+        end = RDRAM_GDB_SIZE / RDRAM_GDB_PAGE_SIZE - 1;
+    // a request larger than the cache cannot be held in it at once
+    if (end - first >= RDRAM_GDB_PAGES)
+        return rdram_gdb_fetch(buf, addr, size);
+
+    if (!rdram_gdb_load_pages(first, end))
+        return false;
+
+    uint8_t *out = buf;
+    while (size != 0) {
+        uint32_t offset = addr % RDRAM_GDB_PAGE_SIZE;
+        size_t   n      = RDRAM_GDB_PAGE_SIZE - offset;
+
+        if (n > size)
+            n = size;
+        memcpy(out, &rdram_gdb_cache.data[(addr / RDRAM_GDB_PAGE_SIZE) % RDRAM_GDB_PAGES][offset], n);
+        out += n;
+        addr += n;
+        size -= n;
+    }
+    return true;
+}
+
+static int
+rdram_gdb_close(void)
+{
+    free(rdram_gdb_reply);
+    rdram_gdb_reply = NULL;
+
+    int ret = (rdram_gdb_sock >= 0) ? close(rdram_gdb_sock) : 0;
+    rdram_gdb_sock = -1;
+    return ret;
+}
+
+static int
+rdram_gdb_connect(const char *target)
+{
+    if (strncmp(target, "unix:", 5) == 0) {
+        struct sockaddr_un sun = { .sun_family = AF_UNIX };
+
+        if (strlen(&target[5]) >= sizeof(sun.sun_path))
+            return -1;
+        strcpy(sun.sun_path, &target[5]);
+
+        int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock >= 0 && connect(sock, (struct sockaddr *)&sun, sizeof(sun)) != 0) {
+            close(sock);
+            return -1;
+        }
+        return sock;
+    }
+
+    char        host[256];
+    const char *port = strrchr(target, ':');
+
+    if (port == NULL || (size_t)(port - target) >= sizeof(host))
+        return -1;
+    memcpy(host, target, port - target);
+    host[port - target] = '\0';
+
+    struct addrinfo  hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    int              sock = -1;
+
+    if (getaddrinfo(host, port + 1, &hints, &res) != 0)
+        return -1;
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock < 0)
+            continue;
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    return sock;
+}
+
+static int
+rdram_gdb_open(const void *arg)
+{
+    rdram_gdb_sock = rdram_gdb_connect(arg);
+    if (rdram_gdb_sock < 0)
+        return -1; // -1 = could not connect
+
+    rdram_gdb_in.len      = 0;
+    rdram_gdb_in.pos      = 0;
+    rdram_gdb_cur         = 0;
+    rdram_gdb_packet_size = RDRAM_GDB_DEFAULT_PACKET_SIZE;
+    rdram_gdb_reply       = malloc(rdram_gdb_packet_size + 1);
+    if (rdram_gdb_reply == NULL) {
+        rdram_gdb_close();
+        return -2;
+    }
+    for (size_t i = 0; i < RDRAM_GDB_PAGES; i++)
+        rdram_gdb_cache.page[i] = PAGE_NONE;
+
+    // Ask for the stub's packet size so page runs can be fetched in as few packets as possible
+    if (!rdram_gdb_send("qSupported") || rdram_gdb_recv() < 0) {
+        rdram_gdb_close();
+        return -3; // -3 = no response from stub
+    }
+
+    const char   *packet_size = strstr(rdram_gdb_reply, "PacketSize=");
+    unsigned long size;
+
+    if (packet_size != NULL && sscanf(packet_size, "PacketSize=%lx", &size) == 1 &&
+        size > RDRAM_GDB_DEFAULT_PACKET_SIZE) {
+        char *reply = realloc(rdram_gdb_reply, size + 1);
+
+        if (reply != NULL) {
+            rdram_gdb_reply       = reply;
+            rdram_gdb_packet_size = size;
+        }
+    }
+    return 0;
+}
+
+static long
+rdram_gdb_pos(void)
+{
+    return rdram_gdb_cur;
+}
+
+static bool
+rdram_gdb_addr_valid(uint32_t addr)
+{
+    return addr < RDRAM_GDB_SIZE;
+}
+
+static size_t
+rdram_gdb_read(void *buf, size_t elem_size, size_t elem_count)
+{
+    if (elem_size == 0 || rdram_gdb_cur >= RDRAM_GDB_SIZE)
+        return 0;
+
+    size_t n = (RDRAM_GDB_SIZE - rdram_gdb_cur) / elem_size;
+    if (n > elem_count)
+        n = elem_count;
+
+    // Sequential reads walk display lists, fetch ahead of them
+    if (!rdram_gdb_copy(buf, rdram_gdb_cur, n * elem_size, RDRAM_GDB_PREFETCH))
+        return 0;
+    rdram_gdb_cur += n * elem_size;
+    return n;
+}
+
+/**
+ * Returns true if seek to `addr` was successful.
+ */
+static bool
+rdram_gdb_seek(uint32_t addr)
+{
+    if (!rdram_gdb_addr_valid(addr))
+        return false;
+    rdram_gdb_cur = addr;
+    return true;
+}
+
+/**
+ * Returns true if read of `size` bytes at `addr` was successful.
+ */
+static bool
+rdram_gdb_read_at(void *buf, uint32_t addr, size_t size)
+{
+    if (!rdram_gdb_copy(buf, addr, size, 0))
+        return false;
+    rdram_gdb_cur = addr + size;
+    return true;
+}
+
+#else
+
+static int
+rdram_gdb_close(void)
+{
+    return 0;
+}
+
+static int
+rdram_gdb_open(const void *arg)
+{
+    return -1; // not supported
+}
+
+static long
+rdram_gdb_pos(void)
+{
+    return 0;
+}
+
+static bool
+rdram_gdb_addr_valid(uint32_t addr)
+{
+    return false;
+}
+
+static size_t
+rdram_gdb_read(void *buf, size_t elem_size, size_t elem_count)
+{
+    return 0;
+}
+
+static bool
+rdram_gdb_seek(uint32_t addr)
+{
+    return false;
+}
+
+static bool
+rdram_gdb_read_at(void *buf, uint32_t addr, size_t size)
+{
+    return false;
+}
+
+#endif
+
+/**
+ *  RDRAM GDB Remote Interface
+ */
+
+rdram_interface_t rdram_interface_gdb = {
+    rdram_gdb_close, rdram_gdb_open, rdram_gdb_pos,     rdram_gdb_addr_valid,
+    rdram_gdb_read,  rdram_gdb_seek, rdram_gdb_read_at, NULL,
+};
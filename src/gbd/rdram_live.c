@@ -0,0 +1,298 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WINDOWS
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include "libgbd/rdram.h"
+#include "byteorder.h"
+#include "live.h"
+
+/**
+ *  RDRAM Live Implementation
+ *
+ *  Reads RDRAM from a running emulator without dumping it, either from a POSIX shared memory segment the emulator
+ *  exposes (`shm:<name>[:<offset>]`) or from the emulator's address space through `/proc/<pid>/mem`
+ *  (`pid:<pid>:<address of RDRAM>[:<size>]`). Memory is only ever mapped or opened read-only.
+ *
+ *  Emulators usually keep RDRAM as host-endian 32-bit words, so unless it is already big-endian whole words are read
+ *  and converted on every read.
+ */
+
+#define RDRAM_LIVE_DEFAULT_SIZE 0x800000
+
+#ifndef WINDOWS
+
+static const uint8_t   *rdram_live_map;      // shm segment, or NULL when reading /proc/<pid>/mem
+static size_t           rdram_live_map_size; // size of the whole mapping
+static int              rdram_live_fd = -1;
+static off_t            rdram_live_base; // offset of RDRAM in the mapping or process
+static uint32_t         rdram_live_size;
+static uint32_t         rdram_live_cur;
+static enum rdram_order rdram_live_order; // byte order RDRAM is stored in by the emulator
+
+static int
+rdram_live_close(void)
+{
+    if (rdram_live_map != NULL)
+        munmap((void *)rdram_live_map, rdram_live_map_size);
+    rdram_live_map = NULL;
+
+    int ret = (rdram_live_fd >= 0) ? close(rdram_live_fd) : 0;
+    rdram_live_fd = -1;
+    return ret;
+}
+
+static int
+rdram_live_open_shm(const char *name, unsigned long offset)
+{
+    struct stat st;
+
+    rdram_live_fd = shm_open(name, O_RDONLY, 0);
+    if (rdram_live_fd < 0)
+        return -1; // -1 = could not open segment
+
+    if (fstat(rdram_live_fd, &st) != 0 || (unsigned long)st.st_size <= offset) {
+        rdram_live_close();
+        return -2; // -2 = segment too small
+    }
+    rdram_live_map_size = st.st_size;
+
+    void *map = mmap(NULL, rdram_live_map_size, PROT_READ, MAP_SHARED, rdram_live_fd, 0);
+    if (map == MAP_FAILED) {
+        rdram_live_close();
+        return -3; // -3 = could not map segment
+    }
+    rdram_live_map  = map;
+    rdram_live_base = offset;
+    rdram_live_size = (rdram_live_map_size - offset > UINT32_MAX) ? UINT32_MAX : rdram_live_map_size - offset;
+    return 0;
+}
+
+static int
+rdram_live_open_pid(unsigned long pid, unsigned long address, unsigned long size)
+{
+    char path[64];
+
+    snprintf(path, sizeof(path), "/proc/%lu/mem", pid);
+    rdram_live_fd = open(path, O_RDONLY);
+    if (rdram_live_fd < 0)
+        return -1; // -1 = could not open process memory, usually needs ptrace permission
+
+    rdram_live_base = address;
+    rdram_live_size = size;
+    return 0;
+}
+
+/**
+ * Copies up to `size` bytes at `addr` into `buf` as they are stored by the emulator, returns the number of bytes
+ * copied.
+ */
+static size_t
+rdram_live_copy_raw(void *buf, uint32_t addr, size_t size)
+{
+    if (addr >= rdram_live_size)
+        return 0;
+    if (size > rdram_live_size - addr)
+        size = rdram_live_size - addr;
+
+    if (rdram_live_map != NULL) {
+        memcpy(buf, &rdram_live_map[rdram_live_base + addr], size);
+        return size;
+    }
+
+    ssize_t n = pread(rdram_live_fd, buf, size, rdram_live_base + addr);
+    return (n < 0) ? 0 : n;
+}
+
+static int
+rdram_live_open(const void *arg)
+{
+    const rdram_live_arg_t *live_arg = arg;
+    char                    name[256];
+    unsigned long           pid;
+    unsigned long           address;
+    unsigned long           offset = 0;
+    unsigned long           size   = RDRAM_LIVE_DEFAULT_SIZE;
+    int                     ret    = -4; // -4 = bad source
+
+    rdram_live_cur = 0;
+
+    if (sscanf(live_arg->source, "shm:%255[^:]:%li", name, (long *)&offset) >= 1)
+        ret = rdram_live_open_shm(name, offset);
+    else if (sscanf(live_arg->source, "pid:%lu:%li:%li", &pid, (long *)&address, (long *)&size) >= 2 && size != 0 &&
+             size <= UINT32_MAX)
+        ret = rdram_live_open_pid(pid, address, size);
+    if (ret != 0)
+        return ret;
+
+    rdram_live_order = live_arg->order;
+    if (rdram_live_order == RDRAM_ORDER_AUTO) {
+        uint8_t first[4];
+
+        rdram_live_order = rdram_order_detect(first, rdram_live_copy_raw(first, 0, sizeof(first)));
+    }
+    return 0;
+}
+
+/**
+ * Returns false if the emulator has gone away, its shared memory segment was removed or its process has exited.
+ */
+bool
+rdram_live_alive(void)
+{
+    struct stat st;
+
+    if (rdram_live_fd < 0)
+        return false;
+    if (rdram_live_map != NULL)
+        return fstat(rdram_live_fd, &st) == 0 && st.st_nlink != 0;
+    return true; // reads from /proc/<pid>/mem fail once the process has exited
+}
+
+static long
+rdram_live_pos(void)
+{
+    return rdram_live_cur;
+}
+
+static bool
+rdram_live_addr_valid(uint32_t addr)
+{
+    return addr < rdram_live_size;
+}
+
+/**
+ * Copies up to `size` bytes at `addr` into `buf` in big-endian order, returns the number of bytes copied.
+ */
+static size_t
+rdram_live_copy(void *buf, uint32_t addr, size_t size)
+{
+    uint8_t *out  = buf;
+    size_t   done = 0;
+
+    if (rdram_live_order == RDRAM_ORDER_BIG)
+        return rdram_live_copy_raw(buf, addr, size);
+
+    while (done < size) {
+        uint8_t  words[0x1000];
+        uint32_t start = (addr + done) & ~3;
+        size_t   skip  = addr + done - start;
+        size_t   want  = (skip + size - done + 3) & ~3;
+        size_t   n     = rdram_live_copy_raw(words, start, (want < sizeof(words)) ? want : sizeof(words));
+
+        if (n <= skip)
+            break;
+        rdram_order_normalize(words, n, rdram_live_order);
+
+        n -= skip;
+        if (n > size - done)
+            n = size - done;
+        memcpy(&out[done], &words[skip], n);
+        done += n;
+    }
+    return done;
+}
+
+static size_t
+rdram_live_read(void *buf, size_t elem_size, size_t elem_count)
+{
+    if (elem_size == 0)
+        return 0;
+
+    size_t n = rdram_live_copy(buf, rdram_live_cur, elem_size * elem_count) / elem_size;
+    rdram_live_cur += n * elem_size;
+    return n;
+}
+
+/**
+ * Returns true if seek to `addr` was successful.
+ */
+static bool
+rdram_live_seek(uint32_t addr)
+{
+    if (!rdram_live_addr_valid(addr))
+        return false;
+    rdram_live_cur = addr;
+    return true;
+}
+
+/**
+ * Returns true if read of `size` bytes at `addr` was successful.
+ */
+static bool
+rdram_live_read_at(void *buf, uint32_t addr, size_t size)
+{
+    if (rdram_live_copy(buf, addr, size) != size)
+        return false;
+    rdram_live_cur = addr + size;
+    return true;
+}
+
+#else
+
+static int
+rdram_live_close(void)
+{
+    return 0;
+}
+
+static int
+rdram_live_open(const void *arg)
+{
+    return -1; // not supported
+}
+
+bool
+rdram_live_alive(void)
+{
+    return false;
+}
+
+static long
+rdram_live_pos(void)
+{
+    return 0;
+}
+
+static bool
+rdram_live_addr_valid(uint32_t addr)
+{
+    return false;
+}
+
+static size_t
+rdram_live_read(void *buf, size_t elem_size, size_t elem_count)
+{
+    return 0;
+}
+
+static bool
+rdram_live_seek(uint32_t addr)
+{
+    return false;
+}
+
+static bool
+rdram_live_read_at(void *buf, uint32_t addr, size_t size)
+{
+    return false;
+}
+
+#endif
+
+/**
+ *  RDRAM Live Interface
+ */
+
+rdram_interface_t rdram_interface_live = {
+    rdram_live_close, rdram_live_open, rdram_live_pos,     rdram_live_addr_valid,
+    rdram_live_read,  rdram_live_seek, rdram_live_read_at, NULL,
+};
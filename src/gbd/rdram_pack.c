@@ -0,0 +1,203 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WINDOWS
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include "libgbd/rdram.h"
+#include "pack.h"
+
+/**
+ *  RDRAM Pack Implementation
+ *
+ *  Reads a single frame out of a deduplicated multi-frame pack. The pack is memory-mapped so that reads are served
+ *  directly from the shared pages, on Windows pages are instead read from the file as they are accessed.
+ */
+
+static uint32_t *rdram_pack_table; // page index for each page of the frame
+static uint32_t  rdram_pack_size;  // size of the frame's RDRAM
+static uint32_t  rdram_pack_n_pages;
+static uint32_t  rdram_pack_cur;
+#ifdef WINDOWS
+static FILE *rdram_pack_file;
+#else
+static const uint8_t *rdram_pack_map;
+static size_t         rdram_pack_map_size;
+#endif
+
+static int
+rdram_pack_close(void)
+{
+    free(rdram_pack_table);
+    rdram_pack_table = NULL;
+#ifdef WINDOWS
+    return fclose(rdram_pack_file);
+#else
+    return munmap((void *)rdram_pack_map, rdram_pack_map_size);
+#endif
+}
+
+/**
+ * Reads `size` bytes at `offset` in the pack file.
+ */
+static bool
+rdram_pack_file_read(void *buf, uint64_t offset, size_t size)
+{
+#ifdef WINDOWS
+    return fseeko64(rdram_pack_file, offset, SEEK_SET) == 0 && fread(buf, size, 1, rdram_pack_file) == 1;
+#else
+    if (offset > rdram_pack_map_size || size > rdram_pack_map_size - offset)
+        return false;
+    memcpy(buf, &rdram_pack_map[offset], size);
+    return true;
+#endif
+}
+
+static int
+rdram_pack_open(const void *arg)
+{
+    const rdram_pack_arg_t *pack_arg = arg;
+
+#ifdef WINDOWS
+    rdram_pack_file = fopen(pack_arg->path, "rb");
+    if (rdram_pack_file == NULL)
+        return -1;
+#else
+    int fd = open(pack_arg->path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    rdram_pack_map_size = st.st_size;
+    rdram_pack_map      = mmap(NULL, rdram_pack_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (rdram_pack_map == MAP_FAILED)
+        return -1;
+#endif
+
+    uint8_t header[32];
+    uint8_t entry[PACK_DIR_ENTRY_SIZE];
+
+    if (!rdram_pack_file_read(header, 0, sizeof(header)) || memcmp(header, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+        pack_get32(&header[8]) != PACK_VERSION || pack_get32(&header[12]) != PACK_PAGE_SIZE)
+        goto err; // not a pack or unsupported version
+
+    uint32_t n_frames = pack_get32(&header[16]);
+    if (pack_arg->frame >= n_frames)
+        goto err; // no such frame
+
+    rdram_pack_n_pages = pack_get32(&header[20]);
+
+    uint64_t dir_offset = pack_get64(&header[24]);
+    if (!rdram_pack_file_read(entry, dir_offset + (uint64_t)pack_arg->frame * PACK_DIR_ENTRY_SIZE, sizeof(entry)))
+        goto err;
+
+    uint64_t table_offset = pack_get64(&entry[0]);
+    uint32_t n_entries;
+
+    rdram_pack_size  = pack_get32(&entry[8]);
+    n_entries        = (rdram_pack_size + PACK_PAGE_SIZE - 1) / PACK_PAGE_SIZE;
+    rdram_pack_table = malloc(n_entries * sizeof(uint32_t));
+    if (rdram_pack_table == NULL || !rdram_pack_file_read(rdram_pack_table, table_offset, n_entries * sizeof(uint32_t)))
+        goto err;
+
+    for (uint32_t i = 0; i < n_entries; i++) {
+        rdram_pack_table[i] = pack_get32((uint8_t *)&rdram_pack_table[i]);
+        if (rdram_pack_table[i] >= rdram_pack_n_pages)
+            goto err; // corrupt page table
+    }
+
+    rdram_pack_cur = 0;
+    return 0;
+err:
+    rdram_pack_close();
+    return -2;
+}
+
+static long
+rdram_pack_pos(void)
+{
+    return rdram_pack_cur;
+}
+
+static bool
+rdram_pack_addr_valid(uint32_t addr)
+{
+    return addr < rdram_pack_size;
+}
+
+/**
+ * Returns true if seek to `addr` was successful.
+ */
+static bool
+rdram_pack_seek(uint32_t addr)
+{
+    if (!rdram_pack_addr_valid(addr))
+        return false;
+    rdram_pack_cur = addr;
+    return true;
+}
+
+/**
+ * Returns true if read of `size` bytes at `addr` was successful.
+ */
+static bool
+rdram_pack_read_at(void *buf, uint32_t addr, size_t size)
+{
+    uint8_t *out = buf;
+
+    if (addr > rdram_pack_size || size > rdram_pack_size - addr)
+        return false;
+
+    rdram_pack_cur = addr + size;
+
+    // Copy from each page the read spans
+    while (size != 0) {
+        uint32_t page_offset = addr % PACK_PAGE_SIZE;
+        size_t   n           = PACK_PAGE_SIZE - page_offset;
+        uint64_t offset      = PACK_HEADER_SIZE + (uint64_t)rdram_pack_table[addr / PACK_PAGE_SIZE] * PACK_PAGE_SIZE;
+
+        if (n > size)
+            n = size;
+        if (!rdram_pack_file_read(out, offset + page_offset, n))
+            return false;
+
+        out += n;
+        addr += n;
+        size -= n;
+    }
+    return true;
+}
+
+static size_t
+rdram_pack_read(void *buf, size_t elem_size, size_t elem_count)
+{
+    if (elem_size == 0 || rdram_pack_cur >= rdram_pack_size)
+        return 0;
+
+    size_t n = (rdram_pack_size - rdram_pack_cur) / elem_size;
+    if (n > elem_count)
+        n = elem_count;
+
+    return rdram_pack_read_at(buf, rdram_pack_cur, n * elem_size) ? n : 0;
+}
+
+/**
+ *  RDRAM Pack Interface
+ */
+
+rdram_interface_t rdram_interface_pack = {
+    rdram_pack_close, rdram_pack_open, rdram_pack_pos,     rdram_pack_addr_valid,
+    rdram_pack_read,  rdram_pack_seek, rdram_pack_read_at, NULL,
+};
@@ -0,0 +1,272 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libgbd/rdram.h"
+
+/**
+ *  RDRAM Regions Implementation
+ *
+ *  Reads from a partial RDRAM dump that only holds some address ranges. A manifest lists the regions in the dump, one
+ *  per line as `<physical base> <length> <file offset>`, numbers may be decimal or 0x-prefixed hex and anything after
+ *  a `#` is ignored. Addresses outside of all regions are reported as invalid rather than read as zeros.
+ */
+
+typedef struct {
+    uint32_t base;
+    uint32_t size;
+    long     file_offset;
+} RdramRegion;
+
+static FILE        *rdram_regions_file;
+static RdramRegion *rdram_regions;
+static size_t       rdram_regions_count;
+static uint32_t     rdram_regions_cur;
+
+static int
+rdram_regions_cmp(const void *a, const void *b)
+{
+    const RdramRegion *ra = a;
+    const RdramRegion *rb = b;
+
+    return (ra->base > rb->base) - (ra->base < rb->base);
+}
+
+static int
+rdram_regions_close(void)
+{
+    free(rdram_regions);
+    rdram_regions       = NULL;
+    rdram_regions_count = 0;
+    return fclose(rdram_regions_file);
+}
+
+/**
+ * Reads the region manifest, returns false if it is malformed or regions overlap.
+ */
+static bool
+rdram_regions_load_manifest(const char *path)
+{
+    FILE  *f = fopen(path, "r");
+    char   line[256];
+    size_t capacity = 0;
+
+    if (f == NULL)
+        return false;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+            *comment = '\0';
+
+        unsigned long field[3] = { 0 };
+        char         *p = line;
+        int           n;
+
+        for (n = 0; n < 3; n++) {
+            char *end;
+
+            field[n] = strtoul(p, &end, 0);
+            if (end == p)
+                break;
+            p = end;
+        }
+        p += strspn(p, " \t\r\n");
+
+        if (n == 0 && *p == '\0')
+            continue; // blank line
+
+        unsigned long base   = field[0];
+        unsigned long size   = field[1];
+        unsigned long offset = field[2];
+
+        if (n != 3 || *p != '\0' || size == 0 || base > UINT32_MAX || size > UINT32_MAX - base + 1 ||
+            offset > LONG_MAX)
+            goto fail;
+
+        if (rdram_regions_count == capacity) {
+            capacity = (capacity == 0) ? 16 : capacity * 2;
+
+            RdramRegion *regions = realloc(rdram_regions, capacity * sizeof(RdramRegion));
+            if (regions == NULL)
+                goto fail;
+            rdram_regions = regions;
+        }
+        rdram_regions[rdram_regions_count++] = (RdramRegion){
+            .base        = base,
+            .size        = size,
+            .file_offset = offset,
+        };
+    }
+    fclose(f);
+
+    if (rdram_regions_count == 0)
+        return false;
+
+    qsort(rdram_regions, rdram_regions_count, sizeof(RdramRegion), rdram_regions_cmp);
+    for (size_t i = 1; i < rdram_regions_count; i++) {
+        if (rdram_regions[i].base - rdram_regions[i - 1].base < rdram_regions[i - 1].size)
+            return false;
+    }
+    return true;
+fail:
+    fclose(f);
+    return false;
+}
+
+static int
+rdram_regions_open(const void *arg)
+{
+    const rdram_regions_arg_t *regions_arg = arg;
+
+    rdram_regions_file = fopen(regions_arg->path, "rb");
+    if (rdram_regions_file == NULL)
+        return -1; // -1 = could not open file
+
+    if (!rdram_regions_load_manifest(regions_arg->manifest)) {
+        rdram_regions_close();
+        return -2; // -2 = bad manifest
+    }
+    rdram_regions_cur = rdram_regions[0].base;
+    return 0;
+}
+
+static long
+rdram_regions_pos(void)
+{
+    return rdram_regions_cur;
+}
+
+/**
+ * Returns the region containing `addr`, or NULL if it is not in any region.
+ */
+static const RdramRegion *
+rdram_regions_find(uint32_t addr)
+{
+    size_t lo = 0;
+    size_t hi = rdram_regions_count;
+
+    // Find the last region starting at or before addr
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (rdram_regions[mid].base <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return NULL;
+
+    const RdramRegion *region = &rdram_regions[lo - 1];
+    return (addr - region->base < region->size) ? region : NULL;
+}
+
+static bool
+rdram_regions_addr_valid(uint32_t addr)
+{
+    return rdram_regions_find(addr) != NULL;
+}
+
+/**
+ * Returns true if all `size` bytes at `addr` are mapped, the range may span several adjacent regions.
+ */
+static bool
+rdram_regions_range_valid(uint32_t addr, size_t size)
+{
+    const RdramRegion *region = rdram_regions_find(addr);
+    const RdramRegion *end    = &rdram_regions[rdram_regions_count];
+
+    if (region == NULL)
+        return false;
+
+    while (true) {
+        size_t avail = region->size - (addr - region->base);
+
+        if (size <= avail)
+            return true;
+        size -= avail;
+        addr += avail;
+
+        if (++region == end || region->base != addr)
+            return false;
+    }
+}
+
+/**
+ * Copies up to `size` mapped bytes starting at `addr` into `buf`, returns the number of bytes copied.
+ */
+static size_t
+rdram_regions_copy(void *buf, uint32_t addr, size_t size)
+{
+    const RdramRegion *region = rdram_regions_find(addr);
+    const RdramRegion *end    = &rdram_regions[rdram_regions_count];
+    size_t             done   = 0;
+
+    while (region != NULL && done < size) {
+        size_t offset = addr - region->base;
+        size_t n      = region->size - offset;
+
+        if (n > size - done)
+            n = size - done;
+
+        if (fseek(rdram_regions_file, region->file_offset + offset, SEEK_SET) != 0)
+            break;
+        n = fread((uint8_t *)buf + done, 1, n, rdram_regions_file);
+        if (n == 0)
+            break;
+        done += n;
+        addr += n;
+
+        if (addr - region->base == region->size)
+            region = (region + 1 != end && region[1].base == addr) ? region + 1 : NULL;
+    }
+    return done;
+}
+
+static size_t
+rdram_regions_read(void *buf, size_t elem_size, size_t elem_count)
+{
+    if (elem_size == 0)
+        return 0;
+
+    size_t n = rdram_regions_copy(buf, rdram_regions_cur, elem_size * elem_count) / elem_size;
+    rdram_regions_cur += n * elem_size;
+    return n;
+}
+
+/**
+ * Returns true if seek to `addr` was successful.
+ */
+static bool
+rdram_regions_seek(uint32_t addr)
+{
+    if (!rdram_regions_addr_valid(addr))
+        return false;
+    rdram_regions_cur = addr;
+    return true;
+}
+
+/**
+ * Returns true if read of `size` bytes at `addr` was successful.
+ */
+static bool
+rdram_regions_read_at(void *buf, uint32_t addr, size_t size)
+{
+    if (rdram_regions_copy(buf, addr, size) != size)
+        return false;
+    rdram_regions_cur = addr + size;
+    return true;
+}
+
+/**
+ *  RDRAM Regions Interface
+ */
+
+rdram_interface_t rdram_interface_regions = {
+    rdram_regions_close, rdram_regions_open, rdram_regions_pos,     rdram_regions_addr_valid,
+    rdram_regions_read,  rdram_regions_seek, rdram_regions_read_at, rdram_regions_range_valid,
+};
@@ -0,0 +1,321 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef GBD_ZLIB
+#    include <zlib.h>
+#endif
+
+#include "libgbd/rdram.h"
+#include "pack.h"
+#include "savestate.h"
+
+/**
+ *  Emulator Savestates
+ *
+ *  Extracts RDRAM from mupen64plus (.st) and Project64 (.pj) savestates. Either may be stored raw, gzip compressed or
+ *  as the only file in a zip archive. The savestate is inflated as a stream, only RDRAM is kept and it is written
+ *  directly into a single buffer that is then used with the in-memory RDRAM backend.
+ */
+
+#define SS_HEAD_SIZE 0x1000 // amount of the start of the savestate inspected to identify it
+
+// mupen64plus: "M64+SAVE", u32 version, char[32] ROM MD5, registers, then RDRAM
+#define M64P_MAGIC        "M64+SAVE"
+#define M64P_HEADER_SIZE  44
+#define M64P_RDRAM_OFFSET (M64P_HEADER_SIZE + 0x1B0)
+#define M64P_RDRAM_SIZE   0x800000
+
+// Project64: u32 magic, u32 RDRAM size, ..., RDRAM, DMEM, IMEM
+#define PJ64_MAGIC    0x23D8A6C8
+#define PJ64_SP_SIZE  0x2000 // DMEM + IMEM after RDRAM
+#define PJ64_MIN_HEAD 8
+
+// First word of the libultra exception vector at physical 0, "lui $k0, 0x8000"
+#define EXCEPTION_VECTOR_WORD 0x3C1A8000
+
+enum ss_method {
+    SS_STORED,
+    SS_DEFLATE, // raw deflate stream (zip)
+    SS_GZIP,
+};
+
+typedef struct {
+    FILE          *file;
+    enum ss_method method;
+    uint64_t       in_left;  // compressed bytes remaining
+    uint64_t       out_size; // total uncompressed size
+#ifdef GBD_ZLIB
+    z_stream strm;
+    uint8_t  in_buf[0x4000];
+#endif
+} SsStream;
+
+/**
+ * Locates the first file in a zip archive, returns false if it cannot be found or uses an unsupported compression.
+ */
+static bool
+ss_open_zip(SsStream *s)
+{
+    uint8_t buf[0x10000 + 22];
+    long    file_size;
+
+    if (fseek(s->file, 0, SEEK_END) != 0 || (file_size = ftell(s->file)) < 22)
+        return false;
+
+    // Find the end of central directory record, it is followed by a comment of at most 64KB
+    long   tail_size = (file_size < (long)sizeof(buf)) ? file_size : (long)sizeof(buf);
+    long   eocd      = -1;
+    size_t n;
+
+    if (fseek(s->file, file_size - tail_size, SEEK_SET) != 0 || (n = fread(buf, 1, tail_size, s->file)) < 22)
+        return false;
+    for (long i = n - 22; i >= 0; i--) {
+        if (pack_get32(&buf[i]) == 0x06054B50) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0)
+        return false;
+
+    // First central directory entry
+    uint8_t cdir[46];
+    if (fseek(s->file, pack_get32(&buf[eocd + 16]), SEEK_SET) != 0 || fread(cdir, sizeof(cdir), 1, s->file) != 1 ||
+        pack_get32(cdir) != 0x02014B50)
+        return false;
+
+    unsigned method    = cdir[10] | (cdir[11] << 8);
+    uint32_t comp_size = pack_get32(&cdir[20]);
+    uint32_t size      = pack_get32(&cdir[24]);
+    uint32_t local_ofs = pack_get32(&cdir[42]);
+
+    // Skip the local header, its name and extra field lengths may differ from the central directory
+    uint8_t local[30];
+    if (fseek(s->file, local_ofs, SEEK_SET) != 0 || fread(local, sizeof(local), 1, s->file) != 1 ||
+        pack_get32(local) != 0x04034B50)
+        return false;
+    if (fseek(s->file, (local[26] | (local[27] << 8)) + (local[28] | (local[29] << 8)), SEEK_CUR) != 0)
+        return false;
+
+    s->in_left  = comp_size;
+    s->out_size = size;
+
+    switch (method) {
+        case 0:
+            s->method = SS_STORED;
+            return true;
+#ifdef GBD_ZLIB
+        case 8:
+            s->method = SS_DEFLATE;
+            return inflateInit2(&s->strm, -15) == Z_OK;
+#endif
+        default:
+            return false;
+    }
+}
+
+static bool
+ss_open(SsStream *s, const char *path)
+{
+    uint8_t magic[4];
+
+    memset(s, 0, sizeof(*s));
+    s->file = fopen(path, "rb");
+    if (s->file == NULL)
+        return false;
+
+    if (fread(magic, sizeof(magic), 1, s->file) != 1)
+        return false;
+
+    if (pack_get32(magic) == 0x04034B50)
+        return ss_open_zip(s);
+
+    struct stat st;
+    if (fstat(fileno(s->file), &st) != 0)
+        return false;
+    s->in_left = st.st_size;
+
+#ifdef GBD_ZLIB
+    if (magic[0] == 0x1F && magic[1] == 0x8B) {
+        uint8_t isize[4];
+
+        // The uncompressed size modulo 2^32 is stored at the end
+        if (fseek(s->file, -4, SEEK_END) != 0 || fread(isize, sizeof(isize), 1, s->file) != 1)
+            return false;
+        s->out_size = pack_get32(isize);
+        s->method   = SS_GZIP;
+        return fseek(s->file, 0, SEEK_SET) == 0 && inflateInit2(&s->strm, 47) == Z_OK;
+    }
+#endif
+
+    s->out_size = st.st_size;
+    s->method   = SS_STORED;
+    return fseek(s->file, 0, SEEK_SET) == 0;
+}
+
+static void
+ss_close(SsStream *s)
+{
+#ifdef GBD_ZLIB
+    if (s->method != SS_STORED)
+        inflateEnd(&s->strm);
+#endif
+    if (s->file != NULL)
+        fclose(s->file);
+}
+
+/**
+ * Reads the next `size` bytes of the uncompressed savestate, returns the number of bytes read.
+ */
+static size_t
+ss_read(SsStream *s, void *buf, size_t size)
+{
+    if (s->method == SS_STORED) {
+        if (size > s->in_left)
+            size = s->in_left;
+        size = fread(buf, 1, size, s->file);
+        s->in_left -= size;
+        return size;
+    }
+
+#ifdef GBD_ZLIB
+    s->strm.next_out  = buf;
+    s->strm.avail_out = size;
+
+    while (s->strm.avail_out != 0) {
+        if (s->strm.avail_in == 0) {
+            size_t n = (s->in_left < sizeof(s->in_buf)) ? s->in_left : sizeof(s->in_buf);
+
+            n = fread(s->in_buf, 1, n, s->file);
+            if (n == 0)
+                break;
+            s->in_left -= n;
+            s->strm.next_in  = s->in_buf;
+            s->strm.avail_in = n;
+        }
+        if (inflate(&s->strm, Z_NO_FLUSH) != Z_OK)
+            break;
+    }
+    return size - s->strm.avail_out;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Identifies the savestate from its first bytes and finds where RDRAM is, returns false if it is not a savestate.
+ */
+static bool
+ss_locate_rdram(const uint8_t *head, size_t head_size, uint64_t total_size, uint64_t *offset, uint32_t *size)
+{
+    if (head_size >= M64P_HEADER_SIZE && memcmp(head, M64P_MAGIC, sizeof(M64P_MAGIC) - 1) == 0) {
+        *size   = M64P_RDRAM_SIZE;
+        *offset = M64P_RDRAM_OFFSET;
+
+        // The size of the register block before RDRAM has varied between versions, if the exception vector is not
+        // where it is expected look for it nearby
+        if (*offset + 4 <= head_size && pack_get32(&head[*offset]) != EXCEPTION_VECTOR_WORD) {
+            for (size_t i = M64P_HEADER_SIZE; i + 4 <= head_size; i += 4) {
+                if (pack_get32(&head[i]) == EXCEPTION_VECTOR_WORD) {
+                    *offset = i;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    if (head_size >= PJ64_MIN_HEAD && pack_get32(head) == PJ64_MAGIC) {
+        *size = pack_get32(&head[4]);
+        if (*size == 0 || *size + PJ64_SP_SIZE + PJ64_MIN_HEAD > total_size)
+            return false;
+        *offset = total_size - PJ64_SP_SIZE - *size;
+        return true;
+    }
+    return false;
+}
+
+bool
+savestate_detect(const char *path)
+{
+    SsStream s;
+    uint8_t  head[PJ64_MIN_HEAD];
+    bool     is_savestate = false;
+
+    if (ss_open(&s, path) && ss_read(&s, head, sizeof(head)) == sizeof(head))
+        is_savestate = memcmp(head, M64P_MAGIC, sizeof(M64P_MAGIC) - 1) == 0 || pack_get32(head) == PJ64_MAGIC;
+
+    ss_close(&s);
+    return is_savestate;
+}
+
+/**
+ * Extracts RDRAM from the savestate at `path` into a newly allocated buffer, converting it to big-endian.
+ */
+int
+savestate_load(const char *path, rdram_buffer_arg_t *out)
+{
+    SsStream  s;
+    uint8_t   head[SS_HEAD_SIZE];
+    uint8_t  *rdram = NULL;
+    uint64_t  offset;
+    uint32_t  size;
+    size_t    head_size;
+    int       ret = -1;
+
+    if (!ss_open(&s, path))
+        goto done;
+
+    head_size = ss_read(&s, head, sizeof(head));
+    if (!ss_locate_rdram(head, head_size, s.out_size, &offset, &size) || size % 4 != 0)
+        goto done;
+
+    rdram = malloc(size);
+    if (rdram == NULL)
+        goto done;
+
+    // RDRAM may begin inside the part that was already read
+    uint64_t pos = head_size;
+    size_t   got = 0;
+    if (offset < pos) {
+        got = pos - offset;
+        if (got > size)
+            got = size;
+        memcpy(rdram, &head[offset], got);
+    }
+
+    // Skip to RDRAM, reusing the head buffer for discarded data
+    while (pos < offset) {
+        size_t n = (offset - pos < sizeof(head)) ? offset - pos : sizeof(head);
+
+        if (ss_read(&s, head, n) != n)
+            goto done;
+        pos += n;
+    }
+
+    if (ss_read(&s, &rdram[got], size - got) != size - got)
+        goto done;
+
+    // Savestates hold RDRAM as host-endian (little-endian) words
+    for (uint32_t i = 0; i < size; i += 4) {
+        uint32_t w = pack_get32(&rdram[i]);
+
+        rdram[i + 0] = w >> 24;
+        rdram[i + 1] = w >> 16;
+        rdram[i + 2] = w >> 8;
+        rdram[i + 3] = w >> 0;
+    }
+
+    out->data = rdram;
+    out->size = size;
+    rdram     = NULL;
+    ret       = 0;
+done:
+    free(rdram);
+    ss_close(&s);
+    return ret;
+}
@@ -0,0 +1,14 @@
+#ifndef SAVESTATE_H_
+#define SAVESTATE_H_
+
+#include <stdbool.h>
+
+#include "libgbd/rdram.h"
+
+bool
+savestate_detect(const char *path);
+
+int
+savestate_load(const char *path, rdram_buffer_arg_t *out);
+
+#endif
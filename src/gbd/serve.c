@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WINDOWS
+#    include <signal.h>
+#    include <sys/socket.h>
+#    include <sys/un.h>
+#    include <unistd.h>
+#endif
+
+#include "libgbd/gbd.h"
+#include "serve.h"
+
+/**
+ *  Analysis Server
+ *
+ *  Serves analysis requests on a Unix socket so that tools running gbd many times do not pay for process startup and
+ *  cold caches (the iconv descriptor, for one, stays open between requests). Each connection carries one request, a
+ *  single line holding the same arguments as the command line, e.g.
+ *
+ *      ram.bin AUTO --quiet
+ *
+ *  Arguments are separated by whitespace. The reply is the analysis output followed by one line of JSON summarizing
+ *  the result, after which the connection is closed:
+ *
+ *      {"status":0,"task_done":true,"commands":1234,"warnings":2,"errors":0,"first_error":-1}
+ *
+ *  "status" is nonzero if the request could not be analyzed, in which case the other fields are absent. A request of
+ *  `quit` stops the server. Requests are handled one at a time.
+ */
+
+#define SERVE_MAX_REQUEST 4096
+#define SERVE_MAX_ARGS    64
+
+#ifndef WINDOWS
+
+/**
+ * Reads one line from `conn` into `buf`, returns false if the connection ended first or the line is too long.
+ */
+static bool
+serve_read_line(int conn, char *buf, size_t size)
+{
+    size_t len = 0;
+
+    while (len < size - 1) {
+        ssize_t n = recv(conn, &buf[len], 1, 0);
+        if (n <= 0)
+            return false;
+        if (buf[len] == '\n') {
+            buf[len] = '\0';
+            return true;
+        }
+        len++;
+    }
+    return false;
+}
+
+/**
+ * Handles the request on `conn`, returns false if it asked the server to stop.
+ */
+static bool
+serve_connection(int conn, serve_handler_t handler)
+{
+    char  line[SERVE_MAX_REQUEST];
+    char *argv[SERVE_MAX_ARGS + 1];
+    int   argc = 0;
+
+    if (!serve_read_line(conn, line, sizeof(line)))
+        return true;
+
+    argv[argc++] = "gbd";
+    for (char *tok = strtok(line, " \t\r"); tok != NULL && argc < SERVE_MAX_ARGS; tok = strtok(NULL, " \t\r"))
+        argv[argc++] = tok;
+    argv[argc] = NULL;
+
+    if (argc == 2 && strcmp(argv[1], "quit") == 0)
+        return false;
+
+    FILE *out = fdopen(dup(conn), "w");
+    if (out == NULL)
+        return true;
+
+    gbd_result_t result = {
+        .first_error_num = -1,
+    };
+    int status = handler(argc, argv, out, &result);
+
+    if (status != 0) {
+        fprintf(out, "{\"status\":%d}\n", status);
+    } else {
+        fprintf(out,
+                "{\"status\":0,\"task_done\":%s,\"commands\":%d,\"warnings\":%d,\"errors\":%d,"
+                "\"first_error\":%d}\n",
+                result.task_done ? "true" : "false", result.n_gfx, result.n_warnings, result.n_errors,
+                result.first_error_num);
+    }
+    fclose(out);
+    return true;
+}
+
+/**
+ * Serves requests on a Unix socket at `socket_path` until asked to quit.
+ */
+int
+serve(const char *socket_path, serve_handler_t handler)
+{
+    struct sockaddr_un sun = { .sun_family = AF_UNIX };
+
+    if (strlen(socket_path) >= sizeof(sun.sun_path)) {
+        printf("Socket path %s is too long.\n", socket_path);
+        return -1;
+    }
+    strcpy(sun.sun_path, socket_path);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        printf("Could not create socket.\n");
+        return -1;
+    }
+
+    // A socket left behind by a previous server would make bind fail
+    unlink(socket_path);
+    if (bind(sock, (struct sockaddr *)&sun, sizeof(sun)) != 0 || listen(sock, 16) != 0) {
+        printf("Could not listen on %s.\n", socket_path);
+        close(sock);
+        return -1;
+    }
+
+    // Clients that hang up early must not take the server down with them
+    signal(SIGPIPE, SIG_IGN);
+
+    bool running = true;
+    while (running) {
+        int conn = accept(sock, NULL, NULL);
+        if (conn < 0)
+            continue;
+
+        running = serve_connection(conn, handler);
+        close(conn);
+    }
+
+    close(sock);
+    unlink(socket_path);
+    return 0;
+}
+
+#else
+
+int
+serve(const char *socket_path, serve_handler_t handler)
+{
+    printf("--serve is not supported on Windows.\n");
+    return -1;
+}
+
+#endif
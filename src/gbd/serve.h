@@ -0,0 +1,14 @@
+#ifndef SERVE_H_
+#define SERVE_H_
+
+#include <stdio.h>
+
+#include "libgbd/gbd.h"
+
+// Runs one request given as a command line, printing its output to `out` and filling `result` if it analyzed a task
+typedef int (*serve_handler_t)(int argc, char **argv, FILE *out, gbd_result_t *result);
+
+int
+serve(const char *socket_path, serve_handler_t handler);
+
+#endif
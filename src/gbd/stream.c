@@ -0,0 +1,200 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef WINDOWS
+#    include <fcntl.h>
+#    include <io.h>
+#    define NULL_DEVICE "NUL"
+#else
+#    define NULL_DEVICE "/dev/null"
+#endif
+
+#include "libgbd/gbd.h"
+#include "stream.h"
+
+/**
+ *  Streaming Mode
+ *
+ *  Analyzes a sequence of RDRAM frames read from a pipe. Each frame is a 32-bit big-endian byte count followed by
+ *  that many bytes of RDRAM, a count of 0 or the end of the input ends the stream. A reader thread fills one of two
+ *  frame buffers while the other is being analyzed, so at most two frames are held in memory at once.
+ */
+
+#define STREAM_MAX_FRAME_SIZE 0x4000000 // 64MB, far larger than any RDRAM configuration
+
+typedef struct {
+    uint8_t *data;
+    size_t   size;
+    size_t   capacity;
+    bool     ready; // filled by the reader, waiting to be analyzed
+    bool     end;   // no more frames follow, data is not valid
+} StreamFrame;
+
+static struct {
+    FILE            *in;
+    enum rdram_order order; // byte order of the frames
+    StreamFrame      frames[2];
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+} stream;
+
+static bool
+stream_read_frame(StreamFrame *frame)
+{
+    uint8_t header[4];
+
+    if (fread(header, sizeof(header), 1, stream.in) != 1)
+        return false;
+
+    size_t size = ((uint32_t)header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+    if (size == 0)
+        return false;
+    if (size > STREAM_MAX_FRAME_SIZE) {
+        fprintf(stderr, "Frame size 0x%zX too large, ending stream\n", size);
+        return false;
+    }
+
+    if (size > frame->capacity) {
+        uint8_t *new_data = realloc(frame->data, size);
+
+        if (new_data == NULL) {
+            fprintf(stderr, "Failed to allocate 0x%zX byte frame, ending stream\n", size);
+            return false;
+        }
+        frame->data     = new_data;
+        frame->capacity = size;
+    }
+    frame->size = size;
+
+    if (fread(frame->data, size, 1, stream.in) != 1) {
+        fprintf(stderr, "Stream ended in the middle of a frame\n");
+        return false;
+    }
+
+    // Converting here keeps it off the analysis thread
+    enum rdram_order order = stream.order;
+    if (order == RDRAM_ORDER_AUTO)
+        order = rdram_order_detect(frame->data, frame->size);
+    rdram_order_normalize(frame->data, frame->size, order);
+    return true;
+}
+
+static void *
+stream_reader(void *arg)
+{
+    for (int i = 0;; i ^= 1) {
+        StreamFrame *frame = &stream.frames[i];
+
+        // Wait for the analysis to be done with this buffer
+        pthread_mutex_lock(&stream.lock);
+        while (frame->ready)
+            pthread_cond_wait(&stream.cond, &stream.lock);
+        pthread_mutex_unlock(&stream.lock);
+
+        bool got_frame = stream_read_frame(frame);
+
+        pthread_mutex_lock(&stream.lock);
+        frame->end   = !got_frame;
+        frame->ready = true;
+        pthread_cond_broadcast(&stream.cond);
+        pthread_mutex_unlock(&stream.lock);
+
+        if (!got_frame)
+            return NULL;
+    }
+}
+
+/**
+ * Runs the analysis on every frame in the stream at `path` ("-" for stdin), printing one summary line per frame.
+ */
+int
+stream_analyze(const char *path, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
+               struct start_location_info *start_location, enum rdram_order order)
+{
+    pthread_t reader;
+    int       ret = 0;
+
+    if (strcmp(path, "-") == 0) {
+        stream.in = stdin;
+#ifdef WINDOWS
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    } else {
+        stream.in = fopen(path, "rb");
+        if (stream.in == NULL) {
+            printf("Could not open stream %s.\n", path);
+            return -1;
+        }
+    }
+
+    // The full output of each frame is discarded, only the summary is printed
+    FILE *null_out = fopen(NULL_DEVICE, "w");
+    if (null_out == NULL) {
+        printf("Could not open " NULL_DEVICE ".\n");
+        ret = -1;
+        goto close_in;
+    }
+    opts->quiet = true;
+
+    memset(stream.frames, 0, sizeof(stream.frames));
+    stream.order = order;
+    pthread_mutex_init(&stream.lock, NULL);
+    pthread_cond_init(&stream.cond, NULL);
+
+    if (pthread_create(&reader, NULL, stream_reader, NULL) != 0) {
+        printf("Could not start stream reader.\n");
+        ret = -1;
+        goto close_out;
+    }
+
+    for (int frame_num = 0;; frame_num++) {
+        StreamFrame *frame = &stream.frames[frame_num & 1];
+
+        pthread_mutex_lock(&stream.lock);
+        while (!frame->ready)
+            pthread_cond_wait(&stream.cond, &stream.lock);
+        pthread_mutex_unlock(&stream.lock);
+
+        if (frame->end)
+            break;
+
+        rdram_buffer_arg_t arg = {
+            .data = frame->data,
+            .size = frame->size,
+        };
+        gbd_result_t result;
+
+        if (analyze_gbi(null_out, ucodes, opts, &rdram_interface_buffer, &arg, start_location, &result) != 0) {
+            printf("frame %d: FAILED\n", frame_num);
+        } else {
+            printf("frame %d: %s cmds=%d warnings=%d errors=%d", frame_num, result.task_done ? "ok" : "CRASHED",
+                   result.n_gfx, result.n_warnings, result.n_errors);
+            if (result.first_error_num >= 0)
+                printf(" first_error=#%d", result.first_error_num);
+            printf("\n");
+        }
+        fflush(stdout);
+
+        // Hand the buffer back to the reader
+        pthread_mutex_lock(&stream.lock);
+        frame->ready = false;
+        pthread_cond_broadcast(&stream.cond);
+        pthread_mutex_unlock(&stream.lock);
+    }
+
+    pthread_join(reader, NULL);
+    free(stream.frames[0].data);
+    free(stream.frames[1].data);
+close_out:
+    pthread_cond_destroy(&stream.cond);
+    pthread_mutex_destroy(&stream.lock);
+    fclose(null_out);
+close_in:
+    if (stream.in != stdin)
+        fclose(stream.in);
+    return ret;
+}
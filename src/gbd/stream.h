@@ -0,0 +1,11 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include "libgbd/gbd.h"
+#include "byteorder.h"
+
+int
+stream_analyze(const char *path, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
+               struct start_location_info *start_location, enum rdram_order order);
+
+#endif
@@ -0,0 +1,114 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "macros.h"
+
+#define ARENA_ALIGN 16
+
+void
+arena_new(Arena *arena, size_t block_size)
+{
+    arena->head       = NULL;
+    arena->spare      = NULL;
+    arena->block_size = block_size;
+}
+
+static void
+arena_free_blocks(ArenaBlock *block)
+{
+    while (block != NULL) {
+        ArenaBlock *prev = block->prev;
+
+        free(block);
+        block = prev;
+    }
+}
+
+void
+arena_destroy(Arena *arena)
+{
+    arena_free_blocks(arena->head);
+    arena_free_blocks(arena->spare);
+    arena_new(arena, arena->block_size);
+}
+
+static ArenaBlock *
+arena_new_block(Arena *arena, size_t size)
+{
+    ArenaBlock **spare_link = &arena->spare;
+
+    // Reuse a released block if one is large enough
+    while (*spare_link != NULL) {
+        ArenaBlock *spare = *spare_link;
+
+        if (spare->size >= size) {
+            *spare_link = spare->prev;
+            spare->used = 0;
+            return spare;
+        }
+        spare_link = &spare->prev;
+    }
+
+    size = MAX(size, arena->block_size);
+
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (block == NULL)
+        return NULL;
+
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+/**
+ * Returns `size` bytes of uninitialized memory aligned to 16 bytes, or NULL if a new block could not be allocated.
+ */
+void *
+arena_alloc(Arena *arena, size_t size)
+{
+    ArenaBlock *block = arena->head;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (block == NULL || block->size - block->used < size) {
+        block = arena_new_block(arena, size);
+        if (block == NULL)
+            return NULL;
+
+        block->prev = arena->head;
+        arena->head = block;
+    }
+
+    void *ptr = &block->data[block->used];
+    block->used += size;
+    return ptr;
+}
+
+ArenaMark
+arena_mark(Arena *arena)
+{
+    ArenaMark mark = {
+        .block = arena->head,
+        .used  = (arena->head != NULL) ? arena->head->used : 0,
+    };
+    return mark;
+}
+
+/**
+ * Releases everything allocated since `mark` was taken.
+ */
+void
+arena_release(Arena *arena, ArenaMark mark)
+{
+    while (arena->head != mark.block) {
+        ArenaBlock *block = arena->head;
+
+        arena->head  = block->prev;
+        block->prev  = arena->spare;
+        arena->spare = block;
+    }
+    if (arena->head != NULL)
+        arena->head->used = mark.used;
+}
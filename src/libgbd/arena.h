@@ -0,0 +1,45 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  Bump allocator. Allocations are never freed individually, instead everything allocated after a mark can be
+ *  released at once, or the whole arena destroyed. Released blocks are kept for reuse.
+ */
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *prev;
+    size_t             size;
+    size_t             used;
+    _Alignas(16) uint8_t data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;       // block currently being allocated from
+    ArenaBlock *spare;      // released blocks available for reuse
+    size_t      block_size; // minimum size of new blocks
+} Arena;
+
+typedef struct {
+    ArenaBlock *block;
+    size_t      used;
+} ArenaMark;
+
+void
+arena_new(Arena *arena, size_t block_size);
+
+void
+arena_destroy(Arena *arena);
+
+void *
+arena_alloc(Arena *arena, size_t size);
+
+ArenaMark
+arena_mark(Arena *arena);
+
+void
+arena_release(Arena *arena, ArenaMark mark);
+
+#endif
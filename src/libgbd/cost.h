@@ -0,0 +1,93 @@
+#ifndef COST_H_
+#define COST_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ *  Cycle cost model for estimating how long the RSP and RDP spend on a graphics task. RSP costs are in RSP cycles and
+ *  are modelled on F3DEX2, RDP costs are in RDP cycles. Both units run at 62.5MHz. The figures are rough averages,
+ *  good for comparing one frame or one display list against another rather than for predicting exact frame times.
+ */
+
+#define COST_CLOCK_MHZ 62.5
+
+// RSP
+#define COST_RSP_CMD         12  // fetching and dispatching any command
+#define COST_RSP_VTX         18  // transforming, projecting and computing clip codes for a vertex
+#define COST_RSP_VTX_LIGHT   10  // per vertex and per light when lighting is on, including the ambient light
+#define COST_RSP_VTX_TEXGEN  8   // per vertex with texture coordinate generation
+#define COST_RSP_VTX_FOG     4   // per vertex with fog
+#define COST_RSP_TRI         50  // triangle setup, culling and writing the edge coefficients
+#define COST_RSP_TRI_SHADE   24  // additional setup for shade coefficients
+#define COST_RSP_TRI_TXTR    24  // additional setup for texture coefficients
+#define COST_RSP_TRI_ZBUF    12  // additional setup for depth coefficients
+#define COST_RSP_TRI_CLIP    400 // clipping a triangle against the near plane or guard band
+#define COST_RSP_MTX         60  // loading a matrix and recomputing the combined matrix
+#define COST_RSP_MTX_MUL     40  // multiplying a matrix into the current one
+#define COST_RSP_MTX_POP     30  // popping the matrix stack and recomputing the combined matrix
+
+// RDP
+#define COST_RDP_PRIM     10 // primitive setup
+#define COST_RDP_LOAD     20 // setting up a texture load, the load then moves 8 bytes per cycle
+#define COST_RDP_PIPESYNC 50 // waiting for the pipeline to drain
+#define COST_RDP_LOADSYNC 25
+#define COST_RDP_TILESYNC 25
+
+/**
+ * Returns the RSP cost of processing one vertex.
+ */
+static inline uint32_t
+cost_rsp_vtx(bool lighting, int num_lights, bool texgen, bool fog)
+{
+    uint32_t cost = COST_RSP_VTX;
+
+    if (lighting)
+        cost += (num_lights + 1) * COST_RSP_VTX_LIGHT;
+    if (texgen)
+        cost += COST_RSP_VTX_TEXGEN;
+    if (fog)
+        cost += COST_RSP_VTX_FOG;
+    return cost;
+}
+
+/**
+ * Returns the RSP cost of setting up one triangle.
+ */
+static inline uint32_t
+cost_rsp_tri(bool shade, bool textured, bool zbuf, bool clipped)
+{
+    uint32_t cost = COST_RSP_TRI;
+
+    if (shade)
+        cost += COST_RSP_TRI_SHADE;
+    if (textured)
+        cost += COST_RSP_TRI_TXTR;
+    if (zbuf)
+        cost += COST_RSP_TRI_ZBUF;
+    if (clipped)
+        cost += COST_RSP_TRI_CLIP;
+    return cost;
+}
+
+/**
+ * Returns the RDP cost of drawing a primitive covering `area` pixels. One and two cycle modes draw one pixel every one
+ * or two cycles, with depth buffering costing about half as much again in memory traffic. Fill mode writes 64 bits
+ * per cycle and copy mode copies 4 texels per cycle.
+ */
+static inline uint64_t
+cost_rdp_prim(bool copy, bool fill, bool two_cycle, bool zbuf, int cimg_bits, double area)
+{
+    double cycles;
+
+    if (fill)
+        cycles = area * cimg_bits / 64.0;
+    else if (copy)
+        cycles = area / 4.0;
+    else
+        cycles = area * (two_cycle ? 2.0 : 1.0) * (zbuf ? 1.5 : 1.0);
+
+    return COST_RDP_PRIM + (uint64_t)cycles;
+}
+
+#endif
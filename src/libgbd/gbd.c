@@ -11,7 +11,15 @@
 #include "gfx.h"
 #include "libgbd/gbd.h"
 #include "vector.h"
+#include "arena.h"
 #include "obstack.h"
+#include "texcache.h"
+#include "tmem.h"
+#include "cost.h"
+#include "raster.h"
+#include "optimize.h"
+#include "hashmap.h"
+#include "xxhash.h"
 #include "macros.h"
 #include "vt.h"
 
@@ -23,6 +31,8 @@
 
 #define KSEG_MASK (0b111 << 29)
 
+#define ARENA_BLOCK_SIZE 0x10000
+
 struct bl_conf {
     // Cycle 1
     int m1a_c1;
@@ -132,18 +142,126 @@ typedef struct {
     qu102_t  lrt; /* tile lower-right t-coordinate */
 } tile_descriptor_t;
 
+// How a triangle fared in the RSP, from the screen positions of its vertices
+enum tri_class {
+    TRI_DRAWN,     // drawn normally
+    TRI_CULLED,    // back or front face culled
+    TRI_OFFSCREEN, // entirely outside of the screen or scissor
+    TRI_TINY,      // covers less than one pixel
+    TRI_CLIPPED,   // crosses the near or far plane or the guard band and must be clipped
+    TRI_CLASS_MAX
+};
+
 typedef struct {
-    uint32_t str_addr;
-    int      line_no;
-    int      dl_stack_top;
+    int      n_cmds;
+    int      n_tris;          // triangles drawn, including each half of a quadrangle and lines
+    int      n_vtx;           // vertices loaded
+    int      n_mtx;           // matrices loaded
+    uint64_t tex_bytes;       // bytes loaded into TMEM
+    uint64_t rsp_cycles;      // estimated, see cost.h
+    uint64_t rdp_cycles;      // estimated, see cost.h
+    int      n_redundant;     // state changes that set a value already in place
+    uint64_t redundant_bytes; // Gfx bytes taken by those
+    int      n_tri_class[TRI_CLASS_MAX];
+} WorkCounters;
+
+typedef struct {
+    uint32_t     str_addr; // 0 for work done outside of any OpenDisp
+    int          line_no;
+    WorkCounters work;
+} DispSite;
+
+typedef struct {
+    uint32_t  str_addr;
+    int       line_no;
+    int       dl_stack_top;
+    DispSite *site; // NULL unless profiling
 } DispEntry;
 
+// A distinct call stack of display lists and DISPs, for folded stack output
+typedef struct {
+    int      depth;
+    uint64_t weight;
+    uint64_t frames[]; // FOLDED_FRAME_DL | physical address, or FOLDED_FRAME_DISP | (file name address << 32 | line)
+} FoldedStack;
+
+typedef struct {
+    int n_loaded;   // vertices loaded
+    int n_unused;   // loaded vertices that were replaced or left at the end of the task without being used
+    int n_reloaded; // vertices loaded while still in the cache in any slot, under the same transform
+    int n_tris;     // triangles drawn
+} VtxCacheStats;
+
+// State a primitive is drawn with, primitives drawn one after another with the same material form a batch
+typedef struct {
+    uint32_t combiner[2];
+    uint32_t othermode[2];
+    uint32_t geometry_mode; // 0 for rectangles, which do not use it
+    uint32_t timg[2];       // RDRAM address the TMEM sampled by each tile was loaded from, 0 if untextured
+    uint64_t tiles;         // hash of the tile descriptors sampled, 0 if untextured
+} MaterialKey;
+
+#define MATERIAL_TRI 0x80000000 // set in MaterialKey.geometry_mode for triangles, not used by any geometry mode
+
+typedef struct {
+    int n_batches;
+    int n_changes;        // state changes between batches, in the order drawn
+    int n_changes_sorted; // state changes if batches that can be drawn in any order were sorted by material
+    int n_loads;          // texture loads between batches, in the order drawn
+    int n_loads_sorted;
+} MaterialStats;
+
+// Work done while a display list is executing, for the cost and vertex cache reports
+typedef struct {
+    uint32_t      addr;  // physical address
+    WorkCounters  self;  // work done by commands in this display list
+    WorkCounters  total; // work done by this display list and everything it calls
+    VtxCacheStats vtx;   // use of vertices loaded by this display list, and triangles drawn by it
+    MaterialStats mat;   // batches drawn by commands in this display list
+} DlProfile;
+
+#define FOLDED_FRAME_DISP (1ULL << 63)
+#define FOLDED_MAX_DEPTH  64
+
+typedef struct {
+    int                 cmd_num;
+    uint32_t            addr;
+    enum tmem_load_type type;
+} TmemReload;
+
+// State changes checked for redundancy
+enum redundant_kind {
+    REDUNDANT_COMBINE,
+    REDUNDANT_OTHERMODE,
+    REDUNDANT_PRIMCOLOR,
+    REDUNDANT_ENVCOLOR,
+    REDUNDANT_GEOMETRYMODE,
+    REDUNDANT_TEXTURE,
+    REDUNDANT_SETTILE,
+    REDUNDANT_SETTILESIZE,
+    REDUNDANT_SEGMENT,
+    REDUNDANT_KIND_MAX
+};
+
+typedef struct {
+    int      count;
+    uint64_t bytes;
+} RedundantStats;
+
+// Half-open range of physical addresses
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} AddrRange;
+
 #define VTX_CACHE_SIZE 32
+#define VTX_SRC_NONE   0xFFFFFFFF // vertex was not loaded from RDRAM as it is now
 
 typedef struct {
     // Options
     gbd_options_t        *options;
     gfx_ucode_registry_t *ucodes;
+    FILE                 *print_out; // where output outside of the disassembly goes, e.g. texture previews
 
     // Task
     gfxd_ucode_t next_ucode;
@@ -152,9 +270,37 @@ typedef struct {
     bool         task_done;
     bool         pipeline_crashed;
     bool         hit_invalid; // whether we hit invalid commands when we crashed
+    int          n_warnings;
+    int          n_errors;
+    int          first_error_num;
     int          multi_packet;
     char         multi_packet_name[32];
     ObStack      disp_stack;
+    WorkCounters work;            // only partially kept up to date here, see work_snapshot
+    HashMap      disp_sites;      // DispSite by file name address and line number
+    ObStack      disp_site_list;  // DispSite*, in order of first OpenDisp
+    DispSite     no_disp_site;    // work done outside of any OpenDisp
+    uint32_t     root_dl;         // physical address the task started at
+    HashMap      folded_stacks;   // FoldedStack by hash of its frames
+    ObStack      folded_list;     // FoldedStack*, in order of first use
+    HashMap      dl_profiles;     // DlProfile by physical address
+    ObStack      dl_profile_list; // DlProfile*, in order of first execution
+    HashMap      rasters;         // Raster by color image physical address, for the overdraw heatmap
+    ObStack      raster_list;     // Raster*, in order of first use
+    uint64_t     pixels_drawn[4]; // pixels rasterized in each cycle type
+    int          n_tris_near;     // triangles crossing the near plane, which are not rasterized
+
+    // Values as last set by a command, for finding redundant state changes
+    uint32_t       known_state;         // bit per redundant_kind whose value has been set in this task
+    uint32_t       known_tiles;         // tile descriptors set by SetTile
+    uint32_t       known_tile_sizes;    // tile descriptors sized by SetTileSize or a load
+    uint32_t       known_segments;      // segments set by a command
+    uint32_t       known_othermode[2];  // othermode bits set by a command
+    uint32_t       known_geometry_mode; // geometry mode bits set or cleared by a command
+    uint32_t       othermode_last[2];   // othermode as of the last othermode command
+    uint32_t       prim_color[2];       // SetPrimColor command words
+    uint32_t       env_color[2];        // SetEnvColor command words
+    RedundantStats redundant[REDUNDANT_KIND_MAX];
 
     int last_combiner_cmd_num;
     int last_geometry_mode_cmd_num;
@@ -186,14 +332,56 @@ typedef struct {
     bool     matrix_modelview_set;
     uint32_t sp_dram_stack_size;
 
+    int      num_lights;
+    int      clip_ratio;
     int      vtx_clipcodes[VTX_CACHE_SIZE];
     uint16_t vtx_depths[VTX_CACHE_SIZE];
     float    vtx_w[VTX_CACHE_SIZE];
+    float    vtx_screen[VTX_CACHE_SIZE][2]; // x and y in pixels
+
+    // Vertex cache utilization
+    uint32_t      vtx_src[VTX_CACHE_SIZE];     // physical address each vertex was loaded from
+    int           vtx_mtx_gen[VTX_CACHE_SIZE]; // mtx_gen each vertex was transformed under
+    bool          vtx_used[VTX_CACHE_SIZE];    // whether each vertex has been used since it was loaded
+    DlProfile    *vtx_loader[VTX_CACHE_SIZE];  // display list that loaded each vertex, NULL if empty
+    int           mtx_gen;                     // changes whenever the transform or lighting applied to vertices changes
+    VtxCacheStats vtx_stats;
+
+    // Material sorting, batches are collected into runs that could be drawn in any order
+    ObStack       mat_run;       // MaterialKey, batches of the open run
+    MaterialKey   mat_cur;       // material as of the last batch drawn
+    MaterialKey   mat_run_start; // material before the first batch of the open run
+    MaterialStats mat_run_stats; // batches of the open run, in the order drawn
+    DlProfile    *mat_prof;      // display list the open run is in
+    int           mat_level;     // dl_stack_top the open run is in
+    int           mat_level_cmd; // command number that display list was called at
+    uint32_t      mat_cimg;      // color image the open run draws to
+    MaterialStats mat_stats;
+
+    // Display list optimization, the commands of the root display list are recorded to be rewritten
+    ObStack opt_cmds;                    // OptCmd, in order
+    int     opt_first;                   // index in opt_cmds of the first packet of the current macro, -1 if none
+    int     opt_pkt;                     // packets of the current macro checked so far
+    int     opt_cur;                     // index in opt_cmds of the packet being checked, -1 if it was not recorded
+    bool    opt_branched;                // the root display list branched away, later commands are not part of it
+    bool    opt_called;                  // the root display list called another since its last recorded command
+    bool    opt_failed;                  // a command could not be recorded
+    int     opt_vtx_cmd[VTX_CACHE_SIZE]; // index in opt_cmds of the SPVertex that loaded each vertex, -1 if none
+
+    // Statistics
+    int       max_dl_stack_top;
+    int       max_matrix_stack_depth;
+    uint64_t  n_gfx_words; // Gfx executed, counting each packet of a multi-packet command
+    AddrRange gfx_run;     // commands executed one after another up to the current one
+    ObStack   gfx_runs;    // AddrRange, earlier runs of commands executed one after another
+    ObStack   pool_refs;   // AddrRange, data referenced inside the gfx pool
 
     int ex3_mat_cull_mode;
 
     // RDP
     tile_descriptor_t tile_descriptors[8];
+    Tmem              tmem;
+    ObStack           tmem_reloads; // TmemReload, loads of data that was already resident
     struct {
         qu102_t ulx;
         qu102_t uly;
@@ -211,6 +399,7 @@ typedef struct {
     bool           pipe_busy;
     unsigned char  tile_busy[8];
     bool           load_busy;
+    bool           tiles_in_use; // a primitive or load since the last pipe or tile sync may still read a tile
     bool           fullsync;
     struct {
         uint32_t addr;
@@ -229,11 +418,21 @@ typedef struct {
         uint32_t width;
         uint32_t addr;
     } last_timg;
+    struct {
+        uint32_t addr;
+        int      count;
+    } last_tlut;
     uint32_t fill_color;
     bool     fill_color_set;
 
+    // Storage for everything that lives as long as the analysis
+    Arena arena;
+
     // RDRAM
     rdram_interface_t *rdram;
+    TexCache           texcache;
+    HashMap            strings; // InternedStr by physical address
+    iconv_t            str_cd;
 } gfx_state_t;
 
 #define CLIP_NEGX (1 << 0)
@@ -244,6 +443,12 @@ typedef struct {
 #define CLIP_Y    (CLIP_NEGY | CLIP_POSY)
 #define CLIP_W    (1 << 4)
 #define CLIP_ALL  (CLIP_NEGX | CLIP_POSX | CLIP_NEGY | CLIP_POSY | CLIP_W)
+// Outside of the guard band set by the clip ratio or beyond the far plane, triangles using the vertex need to be
+// clipped. Not part of CLIP_ALL as display list culling only considers the screen bounds.
+#define CLIP_GUARD (1 << 5)
+#define CLIP_FAR   (1 << 6)
+// A triangle that is not rejected is clipped by the RSP if any of its vertices has one of these
+#define CLIP_CLIPPED (CLIP_W | CLIP_GUARD | CLIP_FAR)
 
 #define OTHERMODE_VAL(state, hi_lo, field) ((state)->othermode_##hi_lo & MDMASK(field))
 
@@ -368,8 +573,13 @@ Warning_Error(gfx_state_t *state, vprint_fn vpfn, enum gbi_warning warn_id, cons
 
     va_end(args);
 
-    if (err)
+    if (err) {
+        if (state->n_errors++ == 0)
+            state->first_error_num = state->n_gfx;
         state->pipeline_crashed = true;
+    } else {
+        state->n_warnings++;
+    }
 }
 
 #define WARNING_ERROR(state, reason, ...) \
@@ -398,61 +608,131 @@ gfx_fprintf_wrapper(FILE *file, const char *fmt, ...)
     return ret;
 }
 
-void
-print_string(gfx_state_t *state, uint32_t str_addr, fprint_fn pfn, FILE *file)
+#define STR_MAX_LEN    1000
+#define STR_READ_CHUNK 128
+
+typedef struct {
+    bool truncated; // no terminator was found within STR_MAX_LEN bytes
+    char str[];     // UTF-8
+} InternedStr;
+
+/**
+ * Reads up to `size` bytes at `addr`, stopping early at the end of RDRAM. Returns the number of bytes read.
+ */
+static size_t
+rdram_read_upto(gfx_state_t *state, char *buf, uint32_t addr, size_t size)
 {
-    iconv_t cd;
-    char    c;
-    char   *in_buf, *out_buf, *iconv_in_buf, *iconv_out_buf;
-    size_t  in_bytes_tot, out_bytes_max, in_bytes_left, out_bytes_left;
-    size_t  str_len = 0;
+    if (state->rdram->read_at(buf, addr, size))
+        return size;
 
-    /* determine the length of the string */
-    state->rdram->seek(str_addr);
-    do {
-        if (state->rdram->read(&c, sizeof(c), 1) != 1)
-            return;
-        str_len++;
+    // Fall back to single bytes to find exactly where the readable region ends
+    size_t n = 0;
+    while (n < size && state->rdram->read_at(&buf[n], addr + n, 1))
+        n++;
+    return n;
+}
 
-        if (str_len > 1000) {
-            pfn(file, "/*no \\0 ?*/");
-            str_len = 10;
-            break;
-        }
-    } while (c != '\0');
+/**
+ * Returns a descriptor converting `encoding` to UTF-8. The descriptor is kept open between analyses so that
+ * repeated analyses in one process (gbd --serve) only open it once.
+ */
+static iconv_t
+str_cd_get(const char *encoding)
+{
+    static iconv_t cd = (iconv_t)-1;
+    static char   *cd_encoding;
 
-    /* open string */
-    pfn(file, "\"");
+    if (cd != (iconv_t)-1 && strcmp(cd_encoding, encoding) == 0)
+        return cd;
 
-    /* read the whole string */
-    in_buf  = malloc(sizeof(char) * str_len);
-    out_buf = malloc(sizeof(wchar_t) * str_len);
+    if (cd != (iconv_t)-1) {
+        iconv_close(cd);
+        free(cd_encoding);
+    }
+    cd          = iconv_open("UTF-8", encoding);
+    cd_encoding = (cd != (iconv_t)-1) ? strdup(encoding) : NULL;
+    if (cd_encoding == NULL && cd != (iconv_t)-1) {
+        iconv_close(cd);
+        cd = (iconv_t)-1;
+    }
+    return cd;
+}
 
-    state->rdram->seek(str_addr);
-    if (state->rdram->read(in_buf, sizeof(char), str_len) != str_len)
-        goto err;
+/**
+ * Converts the string at `str_addr` to UTF-8 using the configured encoding. The result is interned by physical
+ * address so that repeated references, such as the file names in every OpenDisp/CloseDisp, are only converted once.
+ */
+static InternedStr *
+intern_string(gfx_state_t *state, uint32_t str_addr)
+{
+    InternedStr *istr = hashmap_get(&state->strings, str_addr);
+    if (istr != NULL)
+        return istr;
+
+    char   in_buf[STR_MAX_LEN + 1];
+    char   out_buf[sizeof(wchar_t) * (STR_MAX_LEN + 1)];
+    char  *nul       = NULL;
+    size_t str_len   = 0;
+    bool   truncated = false;
+
+    /* determine the length of the string */
+    while (nul == NULL && str_len < sizeof(in_buf)) {
+        size_t n = rdram_read_upto(state, &in_buf[str_len], str_addr + str_len,
+                                   MIN(STR_READ_CHUNK, sizeof(in_buf) - str_len));
+        if (n == 0)
+            return NULL;
+
+        nul = memchr(&in_buf[str_len], '\0', n);
+        str_len += n;
+    }
+    if (nul != NULL) {
+        str_len = nul - in_buf + 1;
+    } else {
+        truncated = true;
+        str_len   = 10;
+    }
 
     /* convert string to UTF-8 */
-    cd = iconv_open("UTF-8", state->options->string_encoding);
+    if (state->str_cd == (iconv_t)-1) {
+        state->str_cd = str_cd_get(state->options->string_encoding);
+        if (state->str_cd == (iconv_t)-1)
+            return NULL;
+    }
 
-    in_bytes_tot   = sizeof(char) * str_len;
-    out_bytes_max  = sizeof(wchar_t) * str_len;
-    in_bytes_left  = in_bytes_tot;
-    out_bytes_left = out_bytes_max;
-    iconv_in_buf   = in_buf;
-    iconv_out_buf  = out_buf;
-    iconv(cd, &iconv_in_buf, &in_bytes_left, &iconv_out_buf, &out_bytes_left);
-    iconv_close(cd);
+    char  *iconv_in_buf   = in_buf;
+    char  *iconv_out_buf  = out_buf;
+    size_t in_bytes_left  = str_len;
+    size_t out_bytes_left = sizeof(wchar_t) * str_len;
 
-    /* print converted string */
-    pfn(file, "%.*s", (int)(out_bytes_max - out_bytes_left), out_buf);
+    iconv(state->str_cd, NULL, NULL, NULL, NULL); // reset shift state
+    iconv(state->str_cd, &iconv_in_buf, &in_bytes_left, &iconv_out_buf, &out_bytes_left);
 
-err:
-    /* close string */
-    pfn(file, "\"");
+    size_t out_len = iconv_out_buf - out_buf;
 
-    free(in_buf);
-    free(out_buf);
+    istr = arena_alloc(&state->arena, sizeof(InternedStr) + out_len + 1);
+    if (istr == NULL)
+        return NULL;
+    istr->truncated = truncated;
+    memcpy(istr->str, out_buf, out_len);
+    istr->str[out_len] = '\0';
+
+    if (hashmap_put(&state->strings, str_addr, istr) != 0)
+        return NULL;
+    return istr;
+}
+
+void
+print_string(gfx_state_t *state, uint32_t str_addr, fprint_fn pfn, FILE *file)
+{
+    InternedStr *istr = intern_string(state, str_addr);
+    if (istr == NULL)
+        return;
+
+    if (istr->truncated)
+        pfn(file, "/*no \\0 ?*/");
+
+    /* print converted string */
+    pfn(file, "\"%s\"", istr->str);
 }
 
 int
@@ -1300,205 +1580,41 @@ print_othermode(FILE *print_out, uint32_t othermode_hi, uint32_t othermode_lo)
     print_othermode_lo(print_out, othermode_lo);
 }
 
-#define PRINT_PX(r, g, b) printf(VT_RGBCOL_S("%d;%d;%d", "%d;%d;%d") "\u2584\u2584", r, g, b, r, g, b)
-
-#define CVT_PX(c, sft, mask) ((((c) >> (sft)) & (mask)) * (255 / (mask)))
+#define PRINT_PX(out, r, g, b) \
+    fprintf(out, VT_RGBCOL_S("%d;%d;%d", "%d;%d;%d") "\u2584\u2584", r, g, b, r, g, b)
 
 int
-draw_last_timg(gfx_state_t *state, uint32_t timg, int fmt, int siz, int height, int width, uint32_t tlut, int tlut_type,
-               int tlut_count)
-{
-    int fmt_siz = FMT_SIZ(fmt, siz);
-
-    state->rdram->seek(timg);
-
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            // TODO implement transparency in some way for all of these
-            switch (fmt_siz) {
-                case FMT_SIZ(G_IM_FMT_I, G_IM_SIZ_4b):
-                    {
-                        uint8_t i4_px_x2;
-
-                        if (state->rdram->read(&i4_px_x2, sizeof(uint8_t), 1) != 1)
-                            goto read_err;
-
-                        PRINT_PX(CVT_PX(i4_px_x2, 4, 15), CVT_PX(i4_px_x2, 4, 15), CVT_PX(i4_px_x2, 4, 15));
-                        j++; // TODO what happens if these 4-bit textures have an odd width?
-                        PRINT_PX(CVT_PX(i4_px_x2, 0, 15), CVT_PX(i4_px_x2, 0, 15), CVT_PX(i4_px_x2, 0, 15));
-                    }
-                    break;
-
-                case FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_4b):
-                    {
-                        uint8_t ia4_px_x2;
-
-                        if (state->rdram->read(&ia4_px_x2, sizeof(uint8_t), 1) != 1)
-                            goto read_err;
-
-                        PRINT_PX(CVT_PX(ia4_px_x2, 5, 7), CVT_PX(ia4_px_x2, 5, 7), CVT_PX(ia4_px_x2, 5, 7));
-                        j++;
-                        PRINT_PX(CVT_PX(ia4_px_x2, 1, 7), CVT_PX(ia4_px_x2, 1, 7), CVT_PX(ia4_px_x2, 1, 7));
-                    }
-                    break;
-
-                case FMT_SIZ(G_IM_FMT_CI, G_IM_SIZ_4b):
-                    {
-                        // TODO previewing of CI4/CI8 textures is unreliable as the TLUT may be loaded after the index
-                        // data
-                        if (tlut == 0 || tlut_type == G_TT_NONE)
-                            goto no_preview;
-
-                        uint8_t ci8_i_x2;
-
-                        if (state->rdram->read(&ci8_i_x2, sizeof(uint8_t), 1) != 1)
-                            goto read_err;
-
-                        uint16_t tlut_pxs[2];
-
-                        uint32_t save_pos = state->rdram->pos();
-                        state->rdram->seek(tlut + sizeof(uint16_t) * (ci8_i_x2 >> 4));
-                        if (state->rdram->read(&tlut_pxs[0], sizeof(uint16_t), 1) != 1)
-                            goto read_err;
-                        state->rdram->seek(tlut + sizeof(uint16_t) * (ci8_i_x2 & 0xF));
-                        if (state->rdram->read(&tlut_pxs[1], sizeof(uint16_t), 1) != 1)
-                            goto read_err;
-                        state->rdram->seek(save_pos);
-
-                        for (int k = 0; k < 2; k++) {
-                            uint16_t tlut_px = BSWAP16(tlut_pxs[k]);
-
-                            switch (tlut_type) {
-                                case G_TT_RGBA16:
-                                    PRINT_PX(CVT_PX(tlut_px, 11, 31), CVT_PX(tlut_px, 6, 31), CVT_PX(tlut_px, 1, 31));
-                                    break;
-
-                                case G_TT_IA16:
-                                    PRINT_PX(CVT_PX(tlut_px, 8, 255), CVT_PX(tlut_px, 8, 255), CVT_PX(tlut_px, 8, 255));
-                                    break;
-                            }
-                        }
-                    }
-                    break;
-
-                case FMT_SIZ(G_IM_FMT_I, G_IM_SIZ_8b):
-                    {
-                        uint8_t i8_px;
-
-                        if (state->rdram->read(&i8_px, sizeof(uint8_t), 1) != 1)
-                            goto read_err;
-
-                        PRINT_PX(CVT_PX(i8_px, 0, 255), CVT_PX(i8_px, 0, 255), CVT_PX(i8_px, 0, 255));
-                    }
-                    break;
-
-                case FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_8b):
-                    {
-                        uint8_t ia8_px;
-
-                        if (state->rdram->read(&ia8_px, sizeof(uint8_t), 1) != 1)
-                            goto read_err;
-
-                        PRINT_PX(CVT_PX(ia8_px, 4, 15), CVT_PX(ia8_px, 4, 15), CVT_PX(ia8_px, 4, 15));
-                    }
-                    break;
-
-                case FMT_SIZ(G_IM_FMT_CI, G_IM_SIZ_8b):
-                    {
-                        if (tlut == 0 || tlut_type == G_TT_NONE)
-                            goto no_preview;
-
-                        uint8_t ci8_i;
-
-                        if (state->rdram->read(&ci8_i, sizeof(uint8_t), 1) != 1)
-                            goto read_err;
-
-                        // if (ci8_i > tlut_count)
-                        //     goto read_err;
-
-                        uint16_t tlut_px;
-
-                        uint32_t save_pos = state->rdram->pos();
-                        state->rdram->seek(tlut + sizeof(uint16_t) * ci8_i);
-                        if (state->rdram->read(&tlut_px, sizeof(uint16_t), 1) != 1)
-                            goto read_err;
-                        state->rdram->seek(save_pos);
-
-                        tlut_px = BSWAP16(tlut_px);
-
-                        switch (tlut_type) {
-                            case G_TT_RGBA16:
-                                PRINT_PX(CVT_PX(tlut_px, 11, 31), CVT_PX(tlut_px, 6, 31), CVT_PX(tlut_px, 1, 31));
-                                break;
-
-                            case G_TT_IA16:
-                                PRINT_PX(CVT_PX(tlut_px, 8, 255), CVT_PX(tlut_px, 8, 255), CVT_PX(tlut_px, 8, 255));
-                                break;
-                        }
-                    }
-                    break;
-
-                case FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_16b):
-                    {
-                        uint16_t ia16_px;
-
-                        if (state->rdram->read(&ia16_px, sizeof(uint16_t), 1) != 1)
-                            goto read_err;
-
-                        ia16_px = BSWAP16(ia16_px);
-
-                        // TODO most of these require the alpha channel to be visible to properly see what these look
-                        // like
-                        PRINT_PX(CVT_PX(ia16_px, 8, 255), CVT_PX(ia16_px, 8, 255), CVT_PX(ia16_px, 8, 255));
-                    }
-                    break;
-
-                case FMT_SIZ(G_IM_FMT_RGBA, G_IM_SIZ_16b):
-                    {
-                        uint16_t rgba16_px;
-
-                        if (state->rdram->read(&rgba16_px, sizeof(uint16_t), 1) != 1)
-                            goto read_err;
-
-                        rgba16_px = BSWAP16(rgba16_px);
-
-                        PRINT_PX(CVT_PX(rgba16_px, 11, 31), CVT_PX(rgba16_px, 6, 31), CVT_PX(rgba16_px, 1, 31));
-                    }
-                    break;
+draw_last_timg(FILE *print_out, gfx_state_t *state, TexEntry *tex)
+{
+    // TODO implement transparency in some way
+    switch (tex->status) {
+        case TEX_OK:
+            if (texcache_decode(&state->texcache, state->rdram, tex) == TEX_OK)
+                break;
+            return draw_last_timg(print_out, state, tex);
 
-                case FMT_SIZ(G_IM_FMT_RGBA, G_IM_SIZ_32b):
-                    {
-                        uint32_t rgba32_px;
+        case TEX_NO_PREVIEW:
+            fprintf(print_out, VT_RGBCOL(255, 110, 0, 255, 255, 255) "CI texture could not be previewed" VT_RST "\n");
+            return 1;
 
-                        if (state->rdram->read(&rgba32_px, sizeof(uint32_t), 1) != 1)
-                            goto read_err;
+        case TEX_READ_ERROR:
+            fprintf(print_out, VT_RGBCOL(255, 0, 0, 255, 255, 255) "READ ERROR" VT_RST "\n");
+            fprintf(print_out, "%08X\n", tex->key.timg);
+            return -1;
 
-                        rgba32_px = BSWAP32(rgba32_px);
+        case TEX_BAD_FMT_SIZ:
+            fprintf(print_out, VT_RST);
+            return -2;
+    }
 
-                        PRINT_PX(CVT_PX(rgba32_px, 24, 255), CVT_PX(rgba32_px, 16, 255), CVT_PX(rgba32_px, 8, 255));
-                    }
-                    break;
+    const uint32_t *px = tex->rgba;
 
-                // TODO YUV? but who even uses YUV (it would also be more useful to show different decoding stages..)
-                default:
-                    goto bad_fmt_siz_err;
-            }
-        }
-        printf(VT_RST "\n");
+    for (int i = 0; i < tex->key.height; i++) {
+        for (int j = 0; j < tex->key.width; j++, px++)
+            PRINT_PX(print_out, (*px >> 24) & 0xFF, (*px >> 16) & 0xFF, (*px >> 8) & 0xFF);
+        fprintf(print_out, VT_RST "\n");
     }
     return 0;
-
-no_preview:
-    printf(VT_RGBCOL(255, 110, 0, 255, 255, 255) "CI texture could not be previewed" VT_RST "\n");
-    return 1;
-
-read_err:
-    printf(VT_RGBCOL(255, 0, 0, 255, 255, 255) "READ ERROR" VT_RST "\n");
-    printf("%08lX\n", state->rdram->pos());
-    return -1;
-bad_fmt_siz_err:
-    printf(VT_RST);
-    return -2;
 }
 
 /**************************************************************************
@@ -1532,13 +1648,15 @@ dl_stack_pop(gfx_state_t *state)
 static int
 dl_stack_push(gfx_state_t *state, uint32_t pc, uint32_t ra)
 {
-    if (state->dl_stack_top == ARRAY_COUNT(state->dl_stack_ra))
+    if (state->dl_stack_top >= (int)ARRAY_COUNT(state->dl_stack_ra) - 1)
         return -1; // push failed, stack full
 
     state->dl_stack_top++;
     state->dl_stack_pc[state->dl_stack_top]       = pc;
     state->dl_stack_ra[state->dl_stack_top]       = ra;
     state->dl_stack_cmd_nums[state->dl_stack_top] = state->n_gfx;
+
+    state->max_dl_stack_top = MAX(state->max_dl_stack_top, state->dl_stack_top);
     return 0;
 }
 
@@ -1564,6 +1682,16 @@ addr_in_rdram(gfx_state_t *state, uint32_t addr)
     return state->rdram->addr_valid(addr & ~KSEG_MASK);
 }
 
+/**
+ * Segmented to physical conversion without any diagnostics, for when the address has already been or will be checked
+ * by the command that actually uses it.
+ */
+static uint32_t
+segment_resolve(gfx_state_t *state, uint32_t addr)
+{
+    return state->segment_table[(addr << 4) >> 28] + (addr & 0x00FFFFFF);
+}
+
 static uint32_t
 segmented_to_physical(gfx_state_t *state, uint32_t addr)
 {
@@ -1576,7 +1704,7 @@ segmented_to_physical(gfx_state_t *state, uint32_t addr)
         ARG_CHECK(state, (addr >> 24) < 16, GW_INVALID_SEGMENT_NUM);
 
     // segment calculation
-    return state->segment_table[num] + (addr & 0x00FFFFFF);
+    return segment_resolve(state, addr);
 }
 
 static uint32_t
@@ -1656,137 +1784,623 @@ mtxf_mtxf_mul_inplace(MtxF *m0, MtxF *m1)
 }
 
 /**************************************************************************
- *  Command Handlers
+ *  Display List Profile
  */
 
-typedef int (*chk_fn)(gfx_state_t *);
+/**
+ * Returns the profile entry for the display list at `addr`, creating it on first use.
+ */
+static DlProfile *
+dl_profile_get(gfx_state_t *state, uint32_t addr)
+{
+    DlProfile *prof = hashmap_get(&state->dl_profiles, addr);
 
-#define CHECK_PIPESYNC(state)       ARG_CHECK(state, !state->pipe_busy, GW_MISSING_PIPESYNC)
-#define CHECK_LOADSYNC(state)       ARG_CHECK(state, !state->load_busy, GW_MISSING_LOADSYNC)
-#define CHECK_TILESYNC(state, tile) ARG_CHECK(state, !state->tile_busy[(tile)], GW_MISSING_TILESYNC)
+    if (prof == NULL) {
+        prof = arena_alloc(&state->arena, sizeof(DlProfile));
+        if (prof == NULL)
+            return NULL;
 
-static int
-chk_Range(gfx_state_t *state, uint32_t addr, size_t len)
-{
-    ARG_CHECK(state, addr_in_rdram(state, addr), GW_ADDR_NOT_IN_RDRAM);
-    if (len != 0)
-        ARG_CHECK(state, addr_in_rdram(state, addr + len), GW_RANGE_NOT_IN_RDRAM);
+        *prof = (DlProfile){
+            .addr = addr,
+        };
+        hashmap_put(&state->dl_profiles, addr, prof);
+        obstack_push(&state->dl_profile_list, &prof);
+    }
+    return prof;
+}
 
-    return 0;
+/**
+ * Returns the profile entry for the display list currently executing.
+ */
+static DlProfile *
+dl_profile_cur(gfx_state_t *state)
+{
+    if (state->dl_stack_top == -1)
+        return dl_profile_get(state, state->root_dl);
+    return dl_profile_get(state, segmented_to_physical(state, state->dl_stack_pc[state->dl_stack_top]));
 }
 
+/**
+ * Fills `path` with the profile entries of the display lists currently on the call stack, outermost first, and
+ * returns how many there are. A display list that calls itself only appears once.
+ */
 static int
-chk_SPBranchList(gfx_state_t *state)
+dl_profile_path(gfx_state_t *state, DlProfile **path)
 {
-    uint32_t dl      = gfxd_arg_value(0)->u;
-    uint32_t dl_phys = segmented_to_physical(state, dl);
+    int n = 0;
 
-    // We don't actually know the length of the display list being branched to,
-    // but it better contain at least one command
-    chk_Range(state, dl_phys, sizeof(Gfx));
+    for (int level = -1; level <= state->dl_stack_top; level++) {
+        uint32_t   addr = (level == -1) ? state->root_dl : segmented_to_physical(state, state->dl_stack_pc[level]);
+        DlProfile *prof = dl_profile_get(state, addr);
 
-    state->gfx_addr = dl_phys - sizeof(Gfx);
-    return 0;
+        if (prof == NULL)
+            continue;
+
+        int i;
+        for (i = 0; i < n && path[i] != prof; i++)
+            ;
+        if (i == n)
+            path[n++] = prof;
+    }
+    return n;
 }
 
-static int
-chk_SPDisplayList(gfx_state_t *state)
-{
-    uint32_t dl = gfxd_arg_value(0)->u;
+/**************************************************************************
+ *  Vertex Cache Utilization
+ */
 
-    if (dl_stack_push(state, dl, state->gfx_addr) == -1)
-        WARNING_ERROR(state, GW_DL_STACK_OVERFLOW);
+/**
+ * Empties a vertex cache slot, counting the vertex in it as unused if nothing used it since it was loaded.
+ */
+static void
+vtx_cache_evict(gfx_state_t *state, int v)
+{
+    DlProfile *loader = state->vtx_loader[v];
 
-    return chk_SPBranchList(state);
+    if (loader != NULL && !state->vtx_used[v]) {
+        loader->vtx.n_unused++;
+        state->vtx_stats.n_unused++;
+    }
+    state->vtx_loader[v] = NULL;
 }
 
-static int
-chk_DisplayList(gfx_state_t *state)
+/**
+ * Records `n` vertices loaded from `addr` into the slots starting at `v0`, noting any that were already there.
+ */
+static void
+vtx_cache_load(gfx_state_t *state, uint32_t addr, int v0, int n)
 {
-    int flag = gfxd_arg_value(1)->u;
+    DlProfile *prof       = dl_profile_cur(state);
+    int        n_loaded   = 0;
+    int        n_reloaded = 0;
 
-    const char *acts_as      = (flag & 1) ? "SPBranchList" : "SPDisplayList";
-    chk_fn      continue_chk = (flag & 1) ? chk_SPBranchList : chk_SPDisplayList;
+    if (prof == NULL)
+        return;
 
-    WARNING_ERROR(state, GW_UNK_DL_VARIANT, acts_as);
+    // Count the vertices that are already in the cache, in any slot, before the load replaces any of them
+    for (int v = v0; v < v0 + n && v < VTX_CACHE_SIZE; v++) {
+        uint32_t src = addr + (v - v0) * sizeof(Vtx);
 
-    return continue_chk(state);
-}
+        for (int i = 0; i < VTX_CACHE_SIZE; i++) {
+            if (state->vtx_loader[i] != NULL && state->vtx_src[i] == src && state->vtx_mtx_gen[i] == state->mtx_gen) {
+                n_reloaded++;
+                break;
+            }
+        }
+    }
 
-static int
-chk_SPEndDisplayList(gfx_state_t *state)
-{
-    if (state->dl_stack_top == -1) // dl stack empty, task is done
-        state->task_done = true;
-    else
-        state->gfx_addr = dl_stack_pop(state);
-    return 0;
-}
+    for (int v = v0; v < v0 + n && v < VTX_CACHE_SIZE; v++) {
+        uint32_t src = addr + (v - v0) * sizeof(Vtx);
 
-static int
-chk_SPCullDisplayList(gfx_state_t *state)
-{
-    int v0 = gfxd_arg_value(0)->i;
-    int vn = gfxd_arg_value(1)->i;
+        vtx_cache_evict(state, v);
+        state->vtx_src[v]     = src;
+        state->vtx_mtx_gen[v] = state->mtx_gen;
+        state->vtx_used[v]    = false;
+        state->vtx_loader[v]  = prof;
+        n_loaded++;
+    }
 
-    int last_loaded_vtx_num = state->last_loaded_vtx_num;
+    prof->vtx.n_loaded += n_loaded;
+    prof->vtx.n_reloaded += n_reloaded;
+    state->vtx_stats.n_loaded += n_loaded;
+    state->vtx_stats.n_reloaded += n_reloaded;
 
-    ARG_CHECK(state, v0 < last_loaded_vtx_num && vn < last_loaded_vtx_num, GW_CULLING_BAD_VERTS);
+    if (n_reloaded != 0)
+        Note(gfxd_vprintf, "%d of %d vertices are already in the cache", n_reloaded, n_loaded);
+}
 
-    ARG_CHECK(state, vn > v0, GW_CULLING_BAD_INDICES);
-    ARG_CHECK(state, v0 >= 0 && vn < VTX_CACHE_SIZE, GW_CULLING_VERTS_OOB);
+static void
+vtx_cache_use(gfx_state_t *state, int v)
+{
+    if ((unsigned)v >= VTX_CACHE_SIZE)
+        return;
 
-    // Skip emulation if vertices are bad
-    if (state->pipeline_crashed)
-        return -1;
+    state->vtx_used[v] = true;
 
-    // Skip emulation if we force culling to always fail
-    if (state->options->no_volume_cull)
-        return 0;
+    if (state->options->optimize_path != NULL && state->opt_vtx_cmd[v] >= 0) {
+        OptCmd *loader = obstack_at(&state->opt_cmds, state->opt_vtx_cmd[v]);
 
-    int check = CLIP_ALL;
+        loader->used_lo = MIN(loader->used_lo, v);
+        loader->used_hi = MAX(loader->used_hi, v);
+    }
+}
 
-    int *startClip = &state->vtx_clipcodes[v0];
-    int *endClip   = &state->vtx_clipcodes[vn];
+/**************************************************************************
+ *  Material Sorting
+ */
 
-    do {
-        check &= *startClip;
-        if (check == 0)
-            return 0; // at least one vertex on-screen, execute next command in display list
-    } while ((startClip++) != endClip);
+/**
+ * Moves `cur` to the material `next`, counting the state changes and texture loads needed. Rectangles leave the
+ * geometry mode as it was, and untextured primitives leave the tiles and TMEM as they were.
+ */
+static void
+material_apply(MaterialKey *cur, const MaterialKey *next, int *n_changes, int *n_loads)
+{
+    if (cur->combiner[0] != next->combiner[0] || cur->combiner[1] != next->combiner[1])
+        (*n_changes)++;
+    if (cur->othermode[0] != next->othermode[0])
+        (*n_changes)++;
+    if (cur->othermode[1] != next->othermode[1])
+        (*n_changes)++;
+    memcpy(cur->combiner, next->combiner, sizeof(cur->combiner));
+    memcpy(cur->othermode, next->othermode, sizeof(cur->othermode));
+
+    if (next->geometry_mode != 0) {
+        if (cur->geometry_mode != next->geometry_mode)
+            (*n_changes)++;
+        cur->geometry_mode = next->geometry_mode;
+    }
 
-    Note(gfxd_vprintf, "Display list culled");
+    if (next->tiles != 0) {
+        if (cur->tiles != next->tiles)
+            (*n_changes)++;
+        for (int i = 0; i < 2; i++) {
+            if (next->timg[i] != 0 && cur->timg[i] != next->timg[i])
+                (*n_loads)++;
+        }
+        memcpy(cur->timg, next->timg, sizeof(cur->timg));
+        cur->tiles = next->tiles;
+    }
+}
 
-    // no vertices on-screen, display list can be culled, end early
-    return chk_SPEndDisplayList(state);
+static bool
+material_equal(const MaterialKey *a, const MaterialKey *b)
+{
+    return a->combiner[0] == b->combiner[0] && a->combiner[1] == b->combiner[1] &&
+           a->othermode[0] == b->othermode[0] && a->othermode[1] == b->othermode[1] &&
+           a->geometry_mode == b->geometry_mode && a->timg[0] == b->timg[0] && a->timg[1] == b->timg[1] &&
+           a->tiles == b->tiles;
 }
 
 static int
-chk_Segment(gfx_state_t *state, int num, uint32_t seg)
+material_cmp(const void *a, const void *b)
 {
-    ARG_CHECK(state, num < 16, GW_INVALID_SEGMENT_NUM);
-    chk_Range(state, seg, sizeof(uint32_t));
+    const MaterialKey *key_a = a;
+    const MaterialKey *key_b = b;
 
-    // Check that segment 0 is assigned to 0. In EX3 it's explicitly reserved
-    // while in other ucode versions it's just conventional, so we treat it as
-    // an error in all ucode versions.
-    ARG_CHECK(state, num != 0 || seg == 0, GW_SEGZERO_NONZERO);
+    // Texture first as loads are the most expensive, then the rest in order of how much changing them costs
+    uint64_t fields_a[] = { key_a->timg[0],      key_a->timg[1],      key_a->combiner[0],   key_a->combiner[1],
+                            key_a->othermode[0], key_a->othermode[1], key_a->geometry_mode, key_a->tiles };
+    uint64_t fields_b[] = { key_b->timg[0],      key_b->timg[1],      key_b->combiner[0],   key_b->combiner[1],
+                            key_b->othermode[0], key_b->othermode[1], key_b->geometry_mode, key_b->tiles };
 
-    state->segment_table[num] = seg & ~KSEG_MASK;
-    state->segment_set_bits |= (1 << num);
+    for (size_t i = 0; i < ARRAY_COUNT(fields_a); i++) {
+        if (fields_a[i] != fields_b[i])
+            return (fields_a[i] < fields_b[i]) ? -1 : 1;
+    }
     return 0;
 }
 
-static int
-chk_SPSegment(gfx_state_t *state)
+/**
+ * Ends the open run of batches, counting the state changes and texture loads the run would have needed had its
+ * batches been sorted by material, starting from the same state.
+ */
+static void
+material_run_end(gfx_state_t *state)
 {
-    int      num = gfxd_arg_value(0)->u;
-    uint32_t seg = gfxd_arg_value(1)->u;
+    MaterialStats *run = &state->mat_run_stats;
 
-    return chk_Segment(state, num, seg);
-}
+    if (state->mat_run.count != 0) {
+        MaterialKey cur = state->mat_run_start;
 
-static int
+        qsort(state->mat_run.start, state->mat_run.count, sizeof(MaterialKey), material_cmp);
+        OBSTACK_FOR_EACH_ELEMENT(&state->mat_run, key, MaterialKey *)
+        {
+            material_apply(&cur, key, &run->n_changes_sorted, &run->n_loads_sorted);
+        }
+
+        MaterialStats *totals[] = { &state->mat_stats, (state->mat_prof != NULL) ? &state->mat_prof->mat : NULL };
+        for (size_t i = 0; i < ARRAY_COUNT(totals); i++) {
+            if (totals[i] == NULL)
+                continue;
+            totals[i]->n_batches += run->n_batches;
+            totals[i]->n_changes += run->n_changes;
+            totals[i]->n_changes_sorted += run->n_changes_sorted;
+            totals[i]->n_loads += run->n_loads;
+            totals[i]->n_loads_sorted += run->n_loads_sorted;
+        }
+    }
+
+    obstack_pop(&state->mat_run, state->mat_run.count);
+    *run                 = (MaterialStats){ 0 };
+    state->mat_run_start = state->mat_cur;
+}
+
+/**
+ * Returns whether primitives drawn now must stay in order relative to their neighbours: those that are blended,
+ * decaled or not depth tested depend on what was drawn before them.
+ */
+static bool
+material_order_dependent(gfx_state_t *state)
+{
+    uint32_t rm         = OTHERMODE_VAL(state, lo, RENDERMODE);
+    int      cycle_type = OTHERMODE_VAL(state, hi, CYCLETYPE);
+
+    if (cycle_type == G_CYC_FILL || cycle_type == G_CYC_COPY)
+        return true;
+    if (!(rm & Z_CMP) || !(rm & Z_UPD) || (rm & FORCE_BL))
+        return true;
+    return (rm & ZMODE_MASK) == ZMODE_XLU || (rm & ZMODE_MASK) == ZMODE_DEC;
+}
+
+/**
+ * Records a primitive for material sorting. `tile` is the render tile, or -1 if the primitive is not textured.
+ * Batches are collected into runs that could be drawn in any order: a run ends whenever the display list level or
+ * color image changes, and primitives whose result depends on draw order form runs of their own.
+ */
+static void
+material_draw(gfx_state_t *state, bool tri, int tile)
+{
+    MaterialKey key = {
+        .combiner      = { state->combiner_hi, state->combiner_lo },
+        .othermode     = { state->othermode_hi, state->othermode_lo },
+        .geometry_mode = tri ? (state->geometry_mode | MATERIAL_TRI) : 0,
+    };
+
+    if (tile >= 0) {
+        int      n_tiles = (OTHERMODE_VAL(state, hi, CYCLETYPE) == G_CYC_2CYCLE) ? 2 : 1;
+        uint32_t fields[2][16];
+
+        for (int i = 0; i < n_tiles; i++) {
+            tile_descriptor_t *tile_desc = get_tile_desc(state, (tile + i) & 7);
+
+            if (tile_desc->tmem < TMEM_WORDS && state->tmem.src[tile_desc->tmem] != TMEM_SRC_NONE)
+                key.timg[i] = state->tmem.src[tile_desc->tmem];
+
+            uint32_t tile_fields[16] = {
+                (tile + i) & 7,      tile_desc->fmt,    tile_desc->siz,   tile_desc->line,  tile_desc->tmem,
+                tile_desc->palette,  tile_desc->cms,    tile_desc->cmt,   tile_desc->masks, tile_desc->maskt,
+                tile_desc->shifts,   tile_desc->shiftt, tile_desc->uls,   tile_desc->ult,   tile_desc->lrs,
+                tile_desc->lrt,
+            };
+            memcpy(fields[i], tile_fields, sizeof(tile_fields));
+        }
+        key.tiles = xxh64(fields, n_tiles * sizeof(fields[0]), 0) | 1; // never 0 for textured primitives
+    }
+
+    int  level     = state->dl_stack_top;
+    int  level_cmd = (level == -1) ? 0 : state->dl_stack_cmd_nums[level];
+    bool ordered   = material_order_dependent(state);
+
+    if (level != state->mat_level || level_cmd != state->mat_level_cmd || state->last_cimg.addr != state->mat_cimg ||
+        ordered) {
+        material_run_end(state);
+        state->mat_prof      = dl_profile_cur(state);
+        state->mat_level     = level;
+        state->mat_level_cmd = level_cmd;
+        state->mat_cimg      = state->last_cimg.addr;
+    }
+
+    MaterialKey *last = obstack_peek(&state->mat_run);
+    if (last == NULL || !material_equal(last, &key)) {
+        obstack_push(&state->mat_run, &key);
+        state->mat_run_stats.n_batches++;
+        material_apply(&state->mat_cur, &key, &state->mat_run_stats.n_changes, &state->mat_run_stats.n_loads);
+    }
+
+    if (ordered)
+        material_run_end(state);
+}
+
+/**************************************************************************
+ *  Display List Optimization
+ */
+
+/**
+ * Returns the recorded command being checked, or NULL if it is not part of the display list being rewritten.
+ */
+static OptCmd *
+opt_cmd_cur(gfx_state_t *state)
+{
+    if (state->options->optimize_path == NULL || state->opt_cur < 0)
+        return NULL;
+    return obstack_at(&state->opt_cmds, state->opt_cur);
+}
+
+/**
+ * Marks the command being checked as having no effect, so that it is left out of the rewritten display list.
+ */
+static void
+opt_drop(gfx_state_t *state)
+{
+    OptCmd *cmd = opt_cmd_cur(state);
+
+    if (cmd != NULL)
+        cmd->drop = true;
+}
+
+/**
+ * Records the RDP cost of the sync being checked, marking it to be dropped if it is superfluous.
+ */
+static void
+opt_sync(gfx_state_t *state, bool superfluous, uint32_t rdp_cost)
+{
+    OptCmd *cmd = opt_cmd_cur(state);
+
+    if (cmd != NULL) {
+        cmd->drop     = superfluous;
+        cmd->rdp_cost = rdp_cost;
+    }
+}
+
+/**
+ * Called after the root display list calls another. What the callee does may differ when the display list is run for
+ * real, for example if it is called through a segment, so nothing it does is relied on: every vertex loaded so far is
+ * kept as it may be drawn with.
+ */
+static void
+opt_call(gfx_state_t *state)
+{
+    for (int v = 0; v < VTX_CACHE_SIZE; v++) {
+        if (state->opt_vtx_cmd[v] >= 0) {
+            OptCmd *loader = obstack_at(&state->opt_cmds, state->opt_vtx_cmd[v]);
+
+            loader->used_lo = MIN(loader->used_lo, v);
+            loader->used_hi = MAX(loader->used_hi, v);
+        }
+        state->opt_vtx_cmd[v] = -1;
+    }
+    state->opt_called = true;
+}
+
+/**
+ * Called on return to the root display list from a call. Any state may have been changed by the callee, so it is no
+ * longer known whether a state change is redundant or a sync is needed.
+ */
+static void
+opt_return(gfx_state_t *state)
+{
+    state->known_state         = 0;
+    state->known_tiles         = 0;
+    state->known_tile_sizes    = 0;
+    state->known_segments      = 0;
+    state->known_othermode[0]  = 0;
+    state->known_othermode[1]  = 0;
+    state->known_geometry_mode = 0;
+    state->pipe_busy           = true;
+    state->load_busy           = true;
+    state->tiles_in_use        = true;
+    state->opt_called          = false;
+}
+
+/**
+ * Records the `n_pkt` packets of the macro about to be checked, if it is part of the root display list.
+ */
+static void
+opt_record(gfx_state_t *state, int n_pkt)
+{
+    state->opt_first = -1;
+    state->opt_pkt   = 0;
+    state->opt_cur   = -1;
+
+    if (state->dl_stack_top != -1 || state->opt_branched)
+        return;
+
+    if (state->opt_called)
+        opt_return(state);
+
+    for (int i = 0; i < n_pkt; i++) {
+        uint8_t pkt[sizeof(Gfx)];
+        OptCmd  cmd = { .used_lo = VTX_CACHE_SIZE, .used_hi = -1 };
+
+        if (!state->rdram->read_at(pkt, state->gfx_addr + i * sizeof(Gfx), sizeof(Gfx))) {
+            state->opt_failed = true;
+            return;
+        }
+        cmd.words[0] = ((uint32_t)pkt[0] << 24) | (pkt[1] << 16) | (pkt[2] << 8) | pkt[3];
+        cmd.words[1] = ((uint32_t)pkt[4] << 24) | (pkt[5] << 16) | (pkt[6] << 8) | pkt[7];
+
+        if (obstack_push(&state->opt_cmds, &cmd) == NULL) {
+            state->opt_failed = true;
+            return;
+        }
+    }
+    state->opt_first = state->opt_cmds.count - n_pkt;
+}
+
+/**************************************************************************
+ *  Command Handlers
+ */
+
+typedef int (*chk_fn)(gfx_state_t *);
+
+#define CHECK_PIPESYNC(state)       ARG_CHECK(state, !state->pipe_busy, GW_MISSING_PIPESYNC)
+#define CHECK_LOADSYNC(state)       ARG_CHECK(state, !state->load_busy, GW_MISSING_LOADSYNC)
+#define CHECK_TILESYNC(state, tile) ARG_CHECK(state, !state->tile_busy[(tile)], GW_MISSING_TILESYNC)
+
+static int
+chk_Range(gfx_state_t *state, uint32_t addr, size_t len)
+{
+    ARG_CHECK(state, addr_in_rdram(state, addr), GW_ADDR_NOT_IN_RDRAM);
+    if (len != 0) {
+        if (state->rdram->range_valid != NULL)
+            ARG_CHECK(state, state->rdram->range_valid(addr & ~KSEG_MASK, len), GW_RANGE_NOT_IN_RDRAM);
+        else
+            ARG_CHECK(state, addr_in_rdram(state, addr + len), GW_RANGE_NOT_IN_RDRAM);
+    }
+
+    uint32_t phys = addr & ~KSEG_MASK;
+    if (state->options->task_stats && len != 0 && phys < state->options->pool_end &&
+        phys + len > state->options->pool_start) {
+        AddrRange ref = { phys, phys + len };
+        obstack_push(&state->pool_refs, &ref);
+    }
+    return 0;
+}
+
+static int
+chk_SPBranchList(gfx_state_t *state)
+{
+    uint32_t dl      = gfxd_arg_value(0)->u;
+    uint32_t dl_phys = segmented_to_physical(state, dl);
+
+    // We don't actually know the length of the display list being branched to,
+    // but it better contain at least one command
+    chk_Range(state, dl_phys, sizeof(Gfx));
+
+    state->gfx_addr = dl_phys - sizeof(Gfx);
+    return 0;
+}
+
+static int
+chk_SPDisplayList(gfx_state_t *state)
+{
+    uint32_t dl = gfxd_arg_value(0)->u;
+
+    if (dl_stack_push(state, dl, state->gfx_addr) == -1)
+        WARNING_ERROR(state, GW_DL_STACK_OVERFLOW);
+
+    return chk_SPBranchList(state);
+}
+
+static int
+chk_DisplayList(gfx_state_t *state)
+{
+    int flag = gfxd_arg_value(1)->u;
+
+    const char *acts_as      = (flag & 1) ? "SPBranchList" : "SPDisplayList";
+    chk_fn      continue_chk = (flag & 1) ? chk_SPBranchList : chk_SPDisplayList;
+
+    WARNING_ERROR(state, GW_UNK_DL_VARIANT, acts_as);
+
+    return continue_chk(state);
+}
+
+static int
+chk_SPEndDisplayList(gfx_state_t *state)
+{
+    if (state->dl_stack_top == -1) // dl stack empty, task is done
+        state->task_done = true;
+    else
+        state->gfx_addr = dl_stack_pop(state);
+    return 0;
+}
+
+static int
+chk_SPCullDisplayList(gfx_state_t *state)
+{
+    int v0 = gfxd_arg_value(0)->i;
+    int vn = gfxd_arg_value(1)->i;
+
+    int last_loaded_vtx_num = state->last_loaded_vtx_num;
+
+    ARG_CHECK(state, v0 < last_loaded_vtx_num && vn < last_loaded_vtx_num, GW_CULLING_BAD_VERTS);
+
+    ARG_CHECK(state, vn > v0, GW_CULLING_BAD_INDICES);
+    ARG_CHECK(state, v0 >= 0 && vn < VTX_CACHE_SIZE, GW_CULLING_VERTS_OOB);
+
+    for (int v = v0; v <= vn; v++)
+        vtx_cache_use(state, v);
+
+    // Skip emulation if vertices are bad
+    if (state->pipeline_crashed)
+        return -1;
+
+    // Skip emulation if we force culling to always fail
+    if (state->options->no_volume_cull)
+        return 0;
+
+    int check = CLIP_ALL;
+
+    int *startClip = &state->vtx_clipcodes[v0];
+    int *endClip   = &state->vtx_clipcodes[vn];
+
+    do {
+        check &= *startClip;
+        if (check == 0)
+            return 0; // at least one vertex on-screen, execute next command in display list
+    } while ((startClip++) != endClip);
+
+    Note(gfxd_vprintf, "Display list culled");
+
+    // no vertices on-screen, display list can be culled, end early
+    return chk_SPEndDisplayList(state);
+}
+
+static const char *
+redundant_kind_str(enum redundant_kind kind)
+{
+    static const char *names[] = {
+        [REDUNDANT_COMBINE]      = "SetCombine",   [REDUNDANT_OTHERMODE]   = "SetOtherMode",
+        [REDUNDANT_PRIMCOLOR]    = "SetPrimColor", [REDUNDANT_ENVCOLOR]    = "SetEnvColor",
+        [REDUNDANT_GEOMETRYMODE] = "GeometryMode", [REDUNDANT_TEXTURE]     = "SPTexture",
+        [REDUNDANT_SETTILE]      = "SetTile",      [REDUNDANT_SETTILESIZE] = "SetTileSize",
+        [REDUNDANT_SEGMENT]      = "SPSegment",
+    };
+    return names[kind];
+}
+
+/**
+ * Records a state change, counting it as redundant if `same` is set and the value was already set by an earlier
+ * command. `known` is the bit in `*known_bits` saying whether the value has been set.
+ */
+static void
+chk_redundant(gfx_state_t *state, enum redundant_kind kind, bool same, uint32_t *known_bits, uint32_t known)
+{
+    // Only redundant if every bit the command writes was already written by an earlier command
+    if (same && known != 0 && (*known_bits & known) == known) {
+        opt_drop(state);
+        state->redundant[kind].count++;
+        state->redundant[kind].bytes += sizeof(Gfx);
+        state->work.n_redundant++;
+        state->work.redundant_bytes += sizeof(Gfx);
+
+        if (state->options->redundant_report)
+            Note(gfxd_vprintf, "Redundant %s, the value is already set", redundant_kind_str(kind));
+    }
+    *known_bits |= known;
+}
+
+static int
+chk_Segment(gfx_state_t *state, int num, uint32_t seg)
+{
+    ARG_CHECK(state, num < 16, GW_INVALID_SEGMENT_NUM);
+    chk_Range(state, seg, sizeof(uint32_t));
+
+    // Check that segment 0 is assigned to 0. In EX3 it's explicitly reserved
+    // while in other ucode versions it's just conventional, so we treat it as
+    // an error in all ucode versions.
+    ARG_CHECK(state, num != 0 || seg == 0, GW_SEGZERO_NONZERO);
+
+    if (num < 16)
+        chk_redundant(state, REDUNDANT_SEGMENT, state->segment_table[num] == (seg & ~KSEG_MASK),
+                      &state->known_segments, 1 << num);
+
+    state->segment_table[num] = seg & ~KSEG_MASK;
+    state->segment_set_bits |= (1 << num);
+    return 0;
+}
+
+static int
+chk_SPSegment(gfx_state_t *state)
+{
+    int      num = gfxd_arg_value(0)->u;
+    uint32_t seg = gfxd_arg_value(1)->u;
+
+    return chk_Segment(state, num, seg);
+}
+
+static int
 chk_SPRelSegment(gfx_state_t *state)
 {
     int      num    = gfxd_arg_value(0)->u;
@@ -1886,6 +2500,10 @@ chk_SPMatrix(gfx_state_t *state)
 
     chk_Range(state, matrix_phys, sizeof(Mtx));
 
+    state->work.n_mtx++;
+    state->mtx_gen++;
+    state->work.rsp_cycles += COST_RSP_MTX + ((param & G_MTX_LOAD) ? 0 : COST_RSP_MTX_MUL);
+
     int projection = (param & G_MTX_PROJECTION) == G_MTX_PROJECTION;
     int push       = (param & G_MTX_PUSH) == G_MTX_PUSH;
     int load       = (param & G_MTX_LOAD) == G_MTX_LOAD;
@@ -1895,6 +2513,7 @@ chk_SPMatrix(gfx_state_t *state)
     if (push) {
         ARG_CHECK(state, state->matrix_stack_depth * sizeof(Mtx) <= state->sp_dram_stack_size, GW_MTX_STACK_OVERFLOW);
         state->matrix_stack_depth++;
+        state->max_matrix_stack_depth = MAX(state->max_matrix_stack_depth, state->matrix_stack_depth);
     }
 
     if (load) {
@@ -2149,9 +2768,23 @@ mtxf_mulvec3(Vec3f *dst, float *w, Vec3f *src, MtxF *mf)
     *w     = src->x * mf->mf[0][3] + src->y * mf->mf[1][3] + src->z * mf->mf[2][3] + mf->mf[3][3];
 }
 
+/**
+ * Loads `num` vertices into the vertex cache starting at `v0`, transforming them as the RSP would so that clip codes,
+ * depths and screen positions are available to later commands.
+ */
 static int
-print_vtx(gfx_state_t *state, uint32_t vtx_addr, int v0, int num)
+load_vtx(gfx_state_t *state, uint32_t vtx_addr, int v0, int num)
 {
+    bool print = state->options->print_vertices;
+
+    // Guard band in screen space, the clip ratio scales the viewport
+    float vp_x  = state->cur_vp.vp.vtrans[0] / 4.0f;
+    float vp_y  = state->cur_vp.vp.vtrans[1] / 4.0f;
+    float vp_sx = state->cur_vp.vp.vscale[0] / 4.0f;
+    float vp_sy = state->cur_vp.vp.vscale[1] / 4.0f;
+    float gb_x  = fabsf(vp_sx) * state->clip_ratio;
+    float gb_y  = fabsf(vp_sy) * state->clip_ratio;
+
     state->rdram->seek(vtx_addr);
 
     for (int i = 0; i < num; i++) {
@@ -2172,9 +2805,11 @@ print_vtx(gfx_state_t *state, uint32_t vtx_addr, int v0, int num)
         vtx.v.tc[0] = BSWAP16(vtx.v.tc[0]);
         vtx.v.tc[1] = BSWAP16(vtx.v.tc[1]);
 
-        gfxd_printf("        { { { %6d, %6d, %6d }, %d, { %6d, %6d }, { %4d, %4d, %4d, %4d } } }\n", vtx.v.ob[0],
-                    vtx.v.ob[1], vtx.v.ob[2], vtx.v.flag, vtx.v.tc[0], vtx.v.tc[1], vtx.v.cn[0], vtx.v.cn[1],
-                    vtx.v.cn[2], vtx.v.cn[3]);
+        if (print) {
+            gfxd_printf("        { { { %6d, %6d, %6d }, %d, { %6d, %6d }, { %4d, %4d, %4d, %4d } } }\n", vtx.v.ob[0],
+                        vtx.v.ob[1], vtx.v.ob[2], vtx.v.flag, vtx.v.tc[0], vtx.v.tc[1], vtx.v.cn[0], vtx.v.cn[1],
+                        vtx.v.cn[2], vtx.v.cn[3]);
+        }
 
         Vec3f model_pos;
         Vec3f screen_pos;
@@ -2185,14 +2820,6 @@ print_vtx(gfx_state_t *state, uint32_t vtx_addr, int v0, int num)
         model_pos.z = vtx.v.ob[2];
         mtxf_mulvec3(&screen_pos, &w, &model_pos, &state->mvp_mtx);
 
-#if 0
-        gfxd_printf("                SCREEN POS { %13.6f %13.6f %13.6f %13.6f }\n",
-                    (state->cur_vp.vp.vtrans[0] / 4.0f) + (screen_pos.x / w) * (state->cur_vp.vp.vscale[0] / 4.0f),
-                    (state->cur_vp.vp.vtrans[1] / 4.0f) + (screen_pos.y / w) * (state->cur_vp.vp.vscale[1] / 4.0f),
-                    (state->cur_vp.vp.vtrans[2] / 4.0f) + (screen_pos.z / w) * (state->cur_vp.vp.vscale[2] / 4.0f),
-                    w);
-#endif
-
         state->vtx_depths[v0 + i] = (screen_pos.z / w) * 1023.0f;
 
         state->vtx_w[v0 + i] = w;
@@ -2209,6 +2836,30 @@ print_vtx(gfx_state_t *state, uint32_t vtx_addr, int v0, int num)
             state->vtx_clipcodes[v0 + i] |= CLIP_NEGY;
         if (w < 0.01f)
             state->vtx_clipcodes[v0 + i] |= CLIP_W;
+        if (screen_pos.z > +w)
+            state->vtx_clipcodes[v0 + i] |= CLIP_FAR;
+
+        if (w >= 0.01f) {
+            // The RSP flips y when applying the viewport so that it points down the screen
+            float sx = (screen_pos.x / w) * vp_sx;
+            float sy = (screen_pos.y / w) * -vp_sy;
+
+            state->vtx_screen[v0 + i][0] = vp_x + sx;
+            state->vtx_screen[v0 + i][1] = vp_y + sy;
+
+            if (fabsf(sx) > gb_x || fabsf(sy) > gb_y)
+                state->vtx_clipcodes[v0 + i] |= CLIP_GUARD;
+        } else {
+            state->vtx_screen[v0 + i][0] = vp_x;
+            state->vtx_screen[v0 + i][1] = vp_y;
+        }
+
+#if 0
+        gfxd_printf("                SCREEN POS { %13.6f %13.6f %13.6f %13.6f }\n",
+                    state->vtx_screen[v0 + i][0], state->vtx_screen[v0 + i][1],
+                    (state->cur_vp.vp.vtrans[2] / 4.0f) + (screen_pos.z / w) * (state->cur_vp.vp.vscale[2] / 4.0f),
+                    w);
+#endif
 
 #if 0
         gfxd_printf("                CLIPCODES { +x %d -x %d +y %d -y %d w %d }\n",
@@ -2222,7 +2873,8 @@ print_vtx(gfx_state_t *state, uint32_t vtx_addr, int v0, int num)
     }
     return 0;
 err:
-    gfxd_printf(VT_COL(RED, WHITE) "READ ERROR" VT_RST "\n");
+    if (print)
+        gfxd_printf(VT_COL(RED, WHITE) "READ ERROR" VT_RST "\n");
     return -1;
 }
 
@@ -2242,10 +2894,33 @@ chk_SPVertex(gfx_state_t *state)
     ARG_CHECK(state, v0 + n <= VTX_CACHE_SIZE, GW_VTX_CACHE_OVERFLOW, n, v0);
     ARG_CHECK(state, v0 >= 0, GW_VTX_CACHE_UNDERFLOW, v0);
 
+    uint32_t vtx_cost = cost_rsp_vtx(state->geometry_mode & G_LIGHTING, state->num_lights,
+                                     state->geometry_mode & G_TEXTURE_GEN, state->geometry_mode & G_FOG);
+
+    if (n > 0) {
+        state->work.n_vtx += n;
+        state->work.rsp_cycles += n * vtx_cost;
+    }
+
     // TODO G_LIGHTING validation
 
-    if (state->options->print_vertices)
-        print_vtx(state, v_phys, v0, n);
+    if (v0 >= 0) {
+        load_vtx(state, v_phys, v0, n);
+
+        if (state->options->vtx_cache_report)
+            vtx_cache_load(state, v_phys, v0, n);
+    }
+
+    OptCmd *cmd = opt_cmd_cur(state);
+    if (cmd != NULL && cmd->kind == OPT_CMD_VTX) {
+        cmd->v0       = v0;
+        cmd->n        = n;
+        cmd->vtx_cost = vtx_cost;
+    }
+    if (state->options->optimize_path != NULL) {
+        for (int v = MAX(v0, 0); v < v0 + n && v < VTX_CACHE_SIZE; v++)
+            state->opt_vtx_cmd[v] = (cmd != NULL && cmd->kind == OPT_CMD_VTX) ? state->opt_cur : -1;
+    }
 
     state->last_loaded_vtx_num = n;
     return 0;
@@ -2262,6 +2937,8 @@ chk_SPViewport(gfx_state_t *state)
     if (!state->rdram->read_at(&state->cur_vp, v_phys, sizeof(Vp)))
         goto err;
 
+    state->mtx_gen++;
+
     state->cur_vp.vp.vscale[0] = BSWAP16(state->cur_vp.vp.vscale[0]);
     state->cur_vp.vp.vscale[1] = BSWAP16(state->cur_vp.vp.vscale[1]);
     state->cur_vp.vp.vscale[2] = BSWAP16(state->cur_vp.vp.vscale[2]);
@@ -2293,6 +2970,44 @@ enum prim_type {
 #define BL_CYC_IS_SET(bl, clk) \
     ((bl)->m1a_c##clk != 0 || (bl)->m1b_c##clk != 0 || (bl)->m2a_c##clk != 0 || (bl)->m2b_c##clk != 0)
 
+/**
+ * Checks that the TMEM sampled by a render tile, and its palette if it is color-indexed, has been loaded.
+ */
+static void
+chk_render_tile_tmem(gfx_state_t *state, int tile, tile_descriptor_t *tile_desc, bool tlut_en)
+{
+    if (tile_desc->line == 0)
+        return;
+
+    // Texels outside of the mask are never sampled
+    unsigned width  = (tile_desc->lrs >> 2) - (tile_desc->uls >> 2) + 1;
+    unsigned height = (tile_desc->lrt >> 2) - (tile_desc->ult >> 2) + 1;
+    if (tile_desc->lrs < tile_desc->uls || (tile_desc->masks != 0 && width > (1u << tile_desc->masks)))
+        width = (tile_desc->masks != 0) ? (1u << tile_desc->masks) : 1;
+    if (tile_desc->lrt < tile_desc->ult || (tile_desc->maskt != 0 && height > (1u << tile_desc->maskt)))
+        height = (tile_desc->maskt != 0) ? (1u << tile_desc->maskt) : 1;
+
+    // 32-bit and color-indexed textures only occupy the low half
+    unsigned max_words = (tile_desc->siz == G_IM_SIZ_32b || tlut_en) ? TMEM_HIGH_WORDS : TMEM_WORDS;
+    unsigned row_words = (width * G_SIZ_BITS(tile_desc->siz) + 63) / 64;
+    if (tile_desc->siz == G_IM_SIZ_32b)
+        row_words = (width + 3) / 4;
+    unsigned n_words = MIN((height - 1) * tile_desc->line + MIN(row_words, (unsigned)tile_desc->line), max_words);
+
+    int unloaded = tmem_first_unloaded(&state->tmem, tile_desc->tmem, n_words);
+    ARG_CHECK(state, unloaded < 0, GW_TILE_SAMPLES_UNLOADED_TMEM, tile, unloaded * 8);
+    tmem_sample(&state->tmem, tile_desc->tmem, n_words);
+
+    if (tile_desc->fmt == G_IM_FMT_CI && tlut_en) {
+        // CI8 palettes are commonly only partially loaded, so only require the first entry
+        int pal_start = (tile_desc->siz == G_IM_SIZ_4b) ? TMEM_HIGH_WORDS + tile_desc->palette * 16 : TMEM_HIGH_WORDS;
+        int pal_words = (tile_desc->siz == G_IM_SIZ_4b) ? 16 : 1;
+
+        ARG_CHECK(state, tmem_first_unloaded(&state->tmem, pal_start, pal_words) < 0, GW_TLUT_NOT_LOADED, tile);
+        tmem_sample(&state->tmem, pal_start, (tile_desc->siz == G_IM_SIZ_4b) ? 16 : TMEM_WORDS - TMEM_HIGH_WORDS);
+    }
+}
+
 static int
 chk_render_tile(gfx_state_t *state, int tile)
 {
@@ -2328,6 +3043,8 @@ chk_render_tile(gfx_state_t *state, int tile)
                     ARG_CHECK(state, tile_desc->fmt == G_IM_FMT_CI || tile_desc->siz == G_IM_SIZ_16b,
                               GW_COPYMODE_MISMATCH_16B);
             }
+
+            chk_render_tile_tmem(state, tile, tile_desc, tlut_en);
         }
     }
 
@@ -2532,10 +3249,187 @@ chk_render_primitive(gfx_state_t *state, enum prim_type prim_type, int tile)
         }
     }
 
-    state->pipe_busy = true;
+    if (state->options->material_report)
+        material_draw(state, prim_type == PRIM_TYPE_TRI,
+                      (prim_type == PRIM_TYPE_TRI && !state->render_tile_on) ? -1 : tile);
+
+    tmem_sample_done(&state->tmem);
+
+    state->pipe_busy    = true;
+    state->tiles_in_use = true;
     return 0;
 }
 
+/**
+ * Returns the signed screen-space area of a triangle in pixels, positive if it is front-facing.
+ */
+static float
+tri_screen_area(gfx_state_t *state, int v0, int v1, int v2)
+{
+    float *p0 = state->vtx_screen[v0];
+    float *p1 = state->vtx_screen[v1];
+    float *p2 = state->vtx_screen[v2];
+
+    // Counter-clockwise is front-facing, with y pointing down the screen that makes the cross product negative
+    return -((p1[0] - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (p1[1] - p0[1])) / 2.0f;
+}
+
+/**
+ * Returns the area in pixels of a rectangle in screen space after scissoring.
+ */
+static float
+rect_scissored_area(gfx_state_t *state, float ulx, float uly, float lrx, float lry)
+{
+    if (state->scissor_set) {
+        ulx = MAX(ulx, state->scissor.ulx / 4.0f);
+        uly = MAX(uly, state->scissor.uly / 4.0f);
+        lrx = MIN(lrx, state->scissor.lrx / 4.0f);
+        lry = MIN(lry, state->scissor.lry / 4.0f);
+    }
+    if (lrx <= ulx || lry <= uly)
+        return 0.0f;
+    return (lrx - ulx) * (lry - uly);
+}
+
+/**
+ * Adds the estimated RDP cost of drawing `area` pixels in the current render mode.
+ */
+static void
+rdp_prim_cost(gfx_state_t *state, float area)
+{
+    int  cycle_type = OTHERMODE_VAL(state, hi, CYCLETYPE);
+    bool zbuf       = (state->othermode_lo & (Z_CMP | Z_UPD)) != 0;
+
+    state->work.rdp_cycles += cost_rdp_prim(cycle_type == G_CYC_COPY, cycle_type == G_CYC_FILL,
+                                            cycle_type == G_CYC_2CYCLE, zbuf, G_SIZ_BITS(state->last_cimg.siz), area);
+}
+
+/**
+ * Returns the overdraw raster for the current color image, creating it on first use. NULL if overdraw is not being
+ * recorded.
+ */
+static Raster *
+raster_cur(gfx_state_t *state)
+{
+    if (state->options->overdraw_path == NULL || !state->cimg_set || state->last_cimg.width == 0)
+        return NULL;
+
+    Raster *r = hashmap_get(&state->rasters, state->last_cimg.addr);
+
+    if (r == NULL) {
+        r = arena_alloc(&state->arena, sizeof(Raster));
+        if (r == NULL || raster_new(r, state->last_cimg.addr, state->last_cimg.width, RASTER_MAX_HEIGHT) != 0)
+            return NULL;
+
+        hashmap_put(&state->rasters, state->last_cimg.addr, r);
+        obstack_push(&state->raster_list, &r);
+    }
+    return r;
+}
+
+/**
+ * Returns the scissor box in whole pixels, or an unbounded box if the scissor was never set.
+ */
+static RasterRect
+raster_scissor(gfx_state_t *state)
+{
+    if (!state->scissor_set)
+        return (RasterRect){ 0, 0, INT32_MAX, INT32_MAX };
+
+    return (RasterRect){
+        .x0 = state->scissor.ulx >> 2,
+        .y0 = state->scissor.uly >> 2,
+        .x1 = state->scissor.lrx >> 2,
+        .y1 = state->scissor.lry >> 2,
+    };
+}
+
+/**
+ * Accounts for a triangle reaching the RSP: classifies it, adds its estimated RSP and RDP cost and rasterizes it for
+ * the overdraw heatmap. Triangles that are trivially rejected or culled only cost the RSP its setup. Triangles that
+ * cross the near plane have no meaningful screen area before clipping, so for those only the RSP cost is counted.
+ */
+static void
+draw_tri(gfx_state_t *state, int v0, int v1, int v2)
+{
+    int            c0      = state->vtx_clipcodes[v0];
+    int            c1      = state->vtx_clipcodes[v1];
+    int            c2      = state->vtx_clipcodes[v2];
+    float         *p0      = state->vtx_screen[v0];
+    float         *p1      = state->vtx_screen[v1];
+    float         *p2      = state->vtx_screen[v2];
+    bool           reject  = (c0 & c1 & c2 & (CLIP_ALL | CLIP_FAR)) != 0; // all outside the same plane, rejected early
+    bool           clipped = ((c0 | c1 | c2) & CLIP_CLIPPED) != 0;
+    float          area    = 0.0f;
+    float          bb      = 0.0f;
+    enum tri_class class   = TRI_DRAWN;
+
+    if (reject) {
+        class = TRI_OFFSCREEN;
+    } else if ((c0 | c1 | c2) & CLIP_W) {
+        class = TRI_CLIPPED;
+    } else {
+        area = tri_screen_area(state, v0, v1, v2);
+        bb   = rect_scissored_area(state, MIN(MIN(p0[0], p1[0]), p2[0]), MIN(MIN(p0[1], p1[1]), p2[1]),
+                                   MAX(MAX(p0[0], p1[0]), p2[0]), MAX(MAX(p0[1], p1[1]), p2[1]));
+
+        if ((area > 0.0f && (state->geometry_mode & G_CULL_FRONT)) ||
+            (area < 0.0f && (state->geometry_mode & G_CULL_BACK)))
+            class = TRI_CULLED;
+        else if (bb == 0.0f)
+            class = TRI_OFFSCREEN;
+        else if (fabsf(area) < 1.0f)
+            class = TRI_TINY;
+        else if (clipped)
+            class = TRI_CLIPPED;
+    }
+    state->work.n_tri_class[class]++;
+
+    if (reject || class == TRI_CULLED) {
+        state->work.rsp_cycles += cost_rsp_tri(false, false, false, false);
+        return;
+    }
+
+    state->work.rsp_cycles +=
+        cost_rsp_tri(state->geometry_mode & G_SHADE, state->render_tile_on, state->geometry_mode & G_ZBUFFER, clipped);
+
+    if ((c0 | c1 | c2) & CLIP_W) {
+        state->n_tris_near++;
+        return;
+    }
+
+    rdp_prim_cost(state, MIN(fabsf(area), bb));
+
+    Raster *r = raster_cur(state);
+    if (r != NULL) {
+        RasterRect scissor = raster_scissor(state);
+
+        state->pixels_drawn[OTHERMODE_VAL(state, hi, CYCLETYPE) >> G_MDSFT_CYCLETYPE] +=
+            raster_tri(r, p0, p1, p2, &scissor);
+    }
+}
+
+/**
+ * Accounts for a rectangle given in 10.2 fixed point: adds its estimated RDP cost and rasterizes it for the overdraw
+ * heatmap. Rectangles include their lower-right edge in fill and copy modes.
+ */
+static void
+draw_rect(gfx_state_t *state, qu102_t ulx, qu102_t uly, qu102_t lrx, qu102_t lry)
+{
+    int   cycle_type = OTHERMODE_VAL(state, hi, CYCLETYPE);
+    float incl       = (cycle_type == G_CYC_FILL || cycle_type == G_CYC_COPY) ? 1.0f : 0.0f;
+
+    rdp_prim_cost(state, rect_scissored_area(state, ulx / 4.0f, uly / 4.0f, lrx / 4.0f + incl, lry / 4.0f + incl));
+
+    Raster *r = raster_cur(state);
+    if (r != NULL) {
+        RasterRect scissor = raster_scissor(state);
+        RasterRect rect    = { ulx >> 2, uly >> 2, (lrx >> 2) + (int)incl, (lry >> 2) + (int)incl };
+
+        state->pixels_drawn[cycle_type >> G_MDSFT_CYCLETYPE] += raster_rect(r, &rect, &scissor);
+    }
+}
+
 static int
 chk_DPFillTriangle(gfx_state_t *state, int tnum, int v0, int v1, int v2, int flag)
 {
@@ -2563,6 +3457,22 @@ chk_DPFillTriangle(gfx_state_t *state, int tnum, int v0, int v1, int v2, int fla
 
     // TODO clip triangles
 
+    state->work.n_tris++;
+
+    if (all_in_bounds)
+        draw_tri(state, v0, v1, v2);
+
+    if (state->options->vtx_cache_report) {
+        DlProfile *prof = dl_profile_cur(state);
+
+        if (prof != NULL)
+            prof->vtx.n_tris++;
+        state->vtx_stats.n_tris++;
+    }
+    vtx_cache_use(state, v0);
+    vtx_cache_use(state, v1);
+    vtx_cache_use(state, v2);
+
     // Base triangle size
     size_t rdp_tri_size = 0x20;
     // Additional optional data
@@ -2655,6 +3565,8 @@ chk_DPFillRectangle(gfx_state_t *state)
 
     // TODO
 
+    draw_rect(state, ulx, uly, lrx, lry);
+
     return chk_render_primitive(state, PRIM_TYPE_FILLRECT, -1);
 }
 
@@ -2667,6 +3579,9 @@ chk_DPSetCombine(gfx_state_t *state)
 
     CHECK_PIPESYNC(state);
 
+    chk_redundant(state, REDUNDANT_COMBINE, cc_hi == state->combiner_hi && cc_lo == state->combiner_lo,
+                  &state->known_state, 1 << REDUNDANT_COMBINE);
+
     state->combiner_hi = cc_hi;
     state->combiner_lo = cc_lo;
     cc_decode(&state->cc, state->combiner_hi, state->combiner_lo);
@@ -2679,9 +3594,22 @@ chk_DPSetCombine(gfx_state_t *state)
 static int
 chk_geometrymode(gfx_state_t *state, uint32_t clear, uint32_t set)
 {
+    bool known = (state->known_geometry_mode & (clear | set)) == (clear | set);
+
+    chk_redundant(state, REDUNDANT_GEOMETRYMODE,
+                  known && ((state->geometry_mode & ~clear) | set) == state->geometry_mode, &state->known_state,
+                  1 << REDUNDANT_GEOMETRYMODE);
+    state->known_geometry_mode |= clear | set;
+
+    uint32_t prev = state->geometry_mode;
+
     state->geometry_mode &= ~clear;
     state->geometry_mode |= set;
 
+    // These change how vertices are lit, texture coordinates generated and fog computed
+    if ((state->geometry_mode ^ prev) & (G_LIGHTING | G_TEXTURE_GEN | G_TEXTURE_GEN_LINEAR | G_FOG))
+        state->mtx_gen++;
+
     state->last_geometry_mode_cmd_num = state->n_gfx;
 
     // TODO check for G_LIGHTING set without G_SHADE and warn
@@ -2725,10 +3653,26 @@ chk_SPClearGeometryMode(gfx_state_t *state)
     return chk_geometrymode(state, clear, set);
 }
 
+/**
+ * Common handling for all othermode commands, `hi_mask` and `lo_mask` are the bits of each othermode word the command
+ * writes.
+ */
 static int
-chk_othermode(gfx_state_t *state)
+chk_othermode(gfx_state_t *state, uint32_t hi_mask, uint32_t lo_mask)
 {
     CHECK_PIPESYNC(state);
+
+    // Callers have already applied the change, compare against the value before it
+    bool known = (state->known_othermode[0] & hi_mask) == hi_mask && (state->known_othermode[1] & lo_mask) == lo_mask;
+    bool same  = ((state->othermode_hi ^ state->othermode_last[0]) & hi_mask) == 0 &&
+                ((state->othermode_lo ^ state->othermode_last[1]) & lo_mask) == 0;
+
+    chk_redundant(state, REDUNDANT_OTHERMODE, known && same, &state->known_state, 1 << REDUNDANT_OTHERMODE);
+    state->known_othermode[0] |= hi_mask;
+    state->known_othermode[1] |= lo_mask;
+    state->othermode_last[0] = state->othermode_hi;
+    state->othermode_last[1] = state->othermode_lo;
+
     bl_decode(&state->bl, OTHERMODE_VAL(state, lo, RENDERMODE));
 
     state->last_othermode_cmd_num = state->n_gfx;
@@ -2743,7 +3687,7 @@ chk_DPPipelineMode(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(PIPELINE);
     state->othermode_hi |= mode & MDMASK(PIPELINE);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(PIPELINE), 0);
 }
 
 static int
@@ -2753,7 +3697,7 @@ chk_DPSetAlphaDither(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(ALPHADITHER);
     state->othermode_hi |= mode & MDMASK(ALPHADITHER);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(ALPHADITHER), 0);
 }
 
 static int
@@ -2763,7 +3707,7 @@ chk_DPSetColorDither(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(RGBDITHER);
     state->othermode_hi |= mode & MDMASK(RGBDITHER);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(RGBDITHER), 0);
 }
 
 static int
@@ -2773,7 +3717,7 @@ chk_DPSetTextureConvert(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(TEXTCONV);
     state->othermode_hi |= mode & MDMASK(TEXTCONV);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(TEXTCONV), 0);
 }
 
 static int
@@ -2783,7 +3727,7 @@ chk_DPSetCycleType(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(CYCLETYPE);
     state->othermode_hi |= mode & MDMASK(CYCLETYPE);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(CYCLETYPE), 0);
 }
 
 static int
@@ -2793,7 +3737,7 @@ chk_DPSetCombineKey(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(COMBKEY);
     state->othermode_hi |= mode & MDMASK(COMBKEY);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(COMBKEY), 0);
 }
 
 static int
@@ -2803,7 +3747,7 @@ chk_DPSetTextureDetail(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(TEXTDETAIL);
     state->othermode_hi |= mode & MDMASK(TEXTDETAIL);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(TEXTDETAIL), 0);
 }
 
 static int
@@ -2813,7 +3757,7 @@ chk_DPSetTextureFilter(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(TEXTFILT);
     state->othermode_hi |= mode & MDMASK(TEXTFILT);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(TEXTFILT), 0);
 }
 
 static int
@@ -2823,7 +3767,7 @@ chk_DPSetTextureLOD(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(TEXTLOD);
     state->othermode_hi |= mode & MDMASK(TEXTLOD);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(TEXTLOD), 0);
 }
 
 static int
@@ -2833,7 +3777,7 @@ chk_DPSetTextureLUT(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(TEXTLUT);
     state->othermode_hi |= mode & MDMASK(TEXTLUT);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(TEXTLUT), 0);
 }
 
 static int
@@ -2843,7 +3787,7 @@ chk_DPSetTexturePersp(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~MDMASK(TEXTPERSP);
     state->othermode_hi |= mode & MDMASK(TEXTPERSP);
-    return chk_othermode(state);
+    return chk_othermode(state, MDMASK(TEXTPERSP), 0);
 }
 
 static int
@@ -2853,7 +3797,7 @@ chk_DPSetAlphaCompare(gfx_state_t *state)
 
     state->othermode_lo &= (~0) & ~MDMASK(ALPHACOMPARE);
     state->othermode_lo |= mode & MDMASK(ALPHACOMPARE);
-    return chk_othermode(state);
+    return chk_othermode(state, 0, MDMASK(ALPHACOMPARE));
 }
 
 static int
@@ -2863,7 +3807,7 @@ chk_DPSetDepthSource(gfx_state_t *state)
 
     state->othermode_lo &= (~0) & ~MDMASK(ZSRCSEL);
     state->othermode_lo |= mode & MDMASK(ZSRCSEL);
-    return chk_othermode(state);
+    return chk_othermode(state, 0, MDMASK(ZSRCSEL));
 }
 
 static int
@@ -2876,7 +3820,7 @@ chk_DPSetRenderMode(gfx_state_t *state)
     state->othermode_lo |= mode1 & MDMASK(RENDERMODE);
     state->othermode_lo |= mode2 & MDMASK(RENDERMODE);
 
-    return chk_othermode(state);
+    return chk_othermode(state, 0, MDMASK(RENDERMODE));
 }
 
 static int
@@ -2889,7 +3833,7 @@ chk_SPSetOtherModeHi(gfx_state_t *state)
 
     state->othermode_hi &= (~0) & ~mask;
     state->othermode_hi |= mode & mask;
-    return chk_othermode(state);
+    return chk_othermode(state, mask, 0);
 }
 
 static int
@@ -2902,7 +3846,7 @@ chk_SPSetOtherModeLo(gfx_state_t *state)
 
     state->othermode_lo &= (~0) & ~mask;
     state->othermode_lo |= mode & mask;
-    return chk_othermode(state);
+    return chk_othermode(state, 0, mask);
 }
 
 static int
@@ -2928,7 +3872,7 @@ chk_SPSetOtherMode(gfx_state_t *state)
         default:
             assert(!"bad opcode in SPSetOtherMode?");
     }
-    return chk_othermode(state);
+    return chk_othermode(state, (opc == G_SETOTHERMODE_H) ? mask : 0, (opc == G_SETOTHERMODE_L) ? mask : 0);
 }
 
 static int
@@ -2939,12 +3883,24 @@ chk_DPSetOtherMode(gfx_state_t *state)
 
     state->othermode_hi = hi;
     state->othermode_lo = lo;
-    return chk_othermode(state);
+    return chk_othermode(state, 0xFFFFFFFF, 0xFFFFFFFF);
 }
 
-#define TMEM_SIZE            0x1000
 #define LOADBLOCK_MAX_TEXELS 2048 // trying to load more than this amount of texels loads nothing
 
+static void
+tmem_chk_load(gfx_state_t *state, enum tmem_load_type type, uint32_t addr, enum tmem_load_result result)
+{
+    if (result == TMEM_LOAD_RESIDENT && state->options->tmem_report) {
+        TmemReload reload = {
+            .cmd_num = state->n_gfx,
+            .addr    = addr,
+            .type    = type,
+        };
+        obstack_push(&state->tmem_reloads, &reload);
+    }
+}
+
 static int
 chk_DPLoadBlock(gfx_state_t *state)
 {
@@ -2969,7 +3925,8 @@ chk_DPLoadBlock(gfx_state_t *state)
 
     // TODO more checks
 
-    state->pipe_busy = true;
+    state->pipe_busy    = true;
+    state->tiles_in_use = true;
     // load_busy = true;
 
     ARG_CHECK(state, state->last_timg.siz != G_IM_SIZ_4b, GW_TIMG_LOAD_4B);
@@ -2983,8 +3940,16 @@ chk_DPLoadBlock(gfx_state_t *state)
         tile_desc->ult = ult; // tl
         tile_desc->lrs = lrs; // sh
         tile_desc->lrt = dxt; // th
+        state->known_tile_sizes |= 1 << tile;
+
+        if (line_texels <= LOADBLOCK_MAX_TEXELS && state->last_timg.siz != G_IM_SIZ_4b) {
+            uint32_t src_addr =
+                state->last_timg.addr + ((ult * state->last_timg.width + uls) * G_SIZ_BITS(state->last_timg.siz)) / 8;
 
-        // TODO loading emulation
+            tmem_chk_load(state, TMEM_LOAD_BLOCK, src_addr,
+                          tmem_load_block(&state->tmem, state->rdram, src_addr, tile_desc->tmem, state->last_timg.siz,
+                                          line_texels, dxt));
+        }
     }
     return 0;
 }
@@ -3012,7 +3977,8 @@ chk_DPLoadTile(gfx_state_t *state)
     ARG_CHECK(state, state->last_timg.siz != G_IM_SIZ_4b, GW_TIMG_LOAD_4B);
 
     // TODO
-    state->pipe_busy = true;
+    state->pipe_busy    = true;
+    state->tiles_in_use = true;
     // load_busy = true;
 
     ARG_CHECK(state, tile_desc != NULL, GW_TILEDESC_BAD, tile);
@@ -3021,6 +3987,19 @@ chk_DPLoadTile(gfx_state_t *state)
         tile_desc->ult = ult;
         tile_desc->lrs = lrs;
         tile_desc->lrt = lrt;
+        state->known_tile_sizes |= 1 << tile;
+
+        if (state->last_timg.siz != G_IM_SIZ_4b && (lrs >> 2) >= (uls >> 2) && (lrt >> 2) >= (ult >> 2)) {
+            // Coordinates are 10.2 fixed point, the fractional part is ignored for loads
+            int      bits     = G_SIZ_BITS(state->last_timg.siz);
+            uint32_t stride   = (state->last_timg.width * bits) / 8;
+            uint32_t src_addr = state->last_timg.addr + (ult >> 2) * stride + ((uls >> 2) * bits) / 8;
+
+            tmem_chk_load(state, TMEM_LOAD_TILE, src_addr,
+                          tmem_load_tile(&state->tmem, state->rdram, src_addr, stride, tile_desc->tmem, tile_desc->line,
+                                         state->last_timg.siz, (lrs >> 2) - (uls >> 2) + 1,
+                                         (lrt >> 2) - (ult >> 2) + 1));
+        }
     }
     return 0;
 }
@@ -3066,7 +4045,8 @@ chk_DPLoadTLUTCmd(gfx_state_t *state)
               timg_fmtsiz == FMT_SIZ(G_IM_FMT_RGBA, G_IM_SIZ_16b) || timg_fmtsiz == FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_16b),
               GW_TLUT_BAD_FMT);
 
-    state->pipe_busy = true;
+    state->pipe_busy    = true;
+    state->tiles_in_use = true;
     // load_busy = true;
 
     ARG_CHECK(state, tile_desc != NULL, GW_TILEDESC_BAD, tile);
@@ -3077,7 +4057,17 @@ chk_DPLoadTLUTCmd(gfx_state_t *state)
         tile_desc->ult = ult;
         tile_desc->lrs = lrs;
         tile_desc->lrt = lrt;
+        state->known_tile_sizes |= 1 << tile;
+
+        if (count < 256)
+            tmem_chk_load(state, TMEM_LOAD_TLUT, state->last_timg.addr,
+                          tmem_load_tlut(&state->tmem, state->rdram, state->last_timg.addr, tile_desc->tmem,
+                                         count + 1));
     }
+
+    // Remember where the palette came from for previewing CI textures
+    state->last_tlut.addr  = state->last_timg.addr;
+    state->last_tlut.count = count + 1;
     return 0;
 }
 
@@ -3085,7 +4075,10 @@ static int
 chk_DPPipeSync(gfx_state_t *state)
 {
     ARG_CHECK(state, state->pipe_busy, GW_SUPERFLUOUS_PIPESYNC);
-    state->pipe_busy = false;
+    opt_sync(state, !state->pipe_busy, COST_RDP_PIPESYNC);
+    state->pipe_busy    = false;
+    state->tiles_in_use = false;
+    state->work.rdp_cycles += COST_RDP_PIPESYNC;
     return 0;
 }
 
@@ -3093,7 +4086,9 @@ static int
 chk_DPLoadSync(gfx_state_t *state)
 {
     ARG_CHECK(state, state->load_busy, GW_SUPERFLUOUS_LOADSYNC);
+    opt_sync(state, !state->load_busy, COST_RDP_LOADSYNC);
     state->load_busy = false;
+    state->work.rdp_cycles += COST_RDP_LOADSYNC;
     return 0;
 }
 
@@ -3105,15 +4100,29 @@ chk_DPTileSync(gfx_state_t *state)
 
     // ARG_CHECK(state, state->tile_busy[], GW_SUPERFLUOUS_TILESYNC);
 
+    // It is certainly superfluous when nothing that reads tile descriptors has happened since the last sync
+    opt_sync(state, !state->tiles_in_use, COST_RDP_TILESYNC);
+    state->tiles_in_use = false;
+
     memset(state->tile_busy, 0, sizeof(state->tile_busy));
+    state->work.rdp_cycles += COST_RDP_TILESYNC;
     return 0;
 }
 
 static int
 chk_DPSetEnvColor(gfx_state_t *state)
 {
+    uint32_t *data = (uint32_t *)(gfxd_macro_data() + gfxd_macro_offset());
+    uint32_t  hi   = BSWAP32(data[0]);
+    uint32_t  lo   = BSWAP32(data[1]);
+
     CHECK_PIPESYNC(state);
 
+    chk_redundant(state, REDUNDANT_ENVCOLOR, hi == state->env_color[0] && lo == state->env_color[1],
+                  &state->known_state, 1 << REDUNDANT_ENVCOLOR);
+    state->env_color[0] = hi;
+    state->env_color[1] = lo;
+
     // TODO
 
     return 0;
@@ -3155,6 +4164,15 @@ chk_DPSetFillColor(gfx_state_t *state)
 static int
 chk_DPSetPrimColor(gfx_state_t *state)
 {
+    uint32_t *data = (uint32_t *)(gfxd_macro_data() + gfxd_macro_offset());
+    uint32_t  hi   = BSWAP32(data[0]);
+    uint32_t  lo   = BSWAP32(data[1]);
+
+    chk_redundant(state, REDUNDANT_PRIMCOLOR, hi == state->prim_color[0] && lo == state->prim_color[1],
+                  &state->known_state, 1 << REDUNDANT_PRIMCOLOR);
+    state->prim_color[0] = hi;
+    state->prim_color[1] = lo;
+
     // TODO
 
     return 0;
@@ -3193,6 +4211,13 @@ chk_DPSetTile(gfx_state_t *state)
     // TODO more checks
 
     if (tile_desc != NULL) {
+        chk_redundant(state, REDUNDANT_SETTILE,
+                      tile_desc->fmt == fmt && tile_desc->siz == siz && tile_desc->line == line &&
+                          tile_desc->tmem == tmem && tile_desc->palette == pal && tile_desc->cmt == cmt &&
+                          tile_desc->maskt == maskt && tile_desc->shiftt == shiftt && tile_desc->cms == cms &&
+                          tile_desc->masks == masks && tile_desc->shifts == shifts,
+                      &state->known_tiles, 1 << tile);
+
         tile_desc->fmt     = fmt;
         tile_desc->siz     = siz;
         tile_desc->line    = line;
@@ -3223,8 +4248,9 @@ chk_DPFullSync(gfx_state_t *state)
 {
     state->pipe_busy = false;
     memset(state->tile_busy, 0, sizeof(state->tile_busy));
-    state->load_busy = false;
-    state->fullsync  = true;
+    state->load_busy    = false;
+    state->tiles_in_use = false;
+    state->fullsync     = true;
     return 0;
 }
 
@@ -3359,6 +4385,10 @@ chk_DPSetTileSize(gfx_state_t *state)
     ARG_CHECK(state, tile_desc != NULL, GW_TILEDESC_BAD, tile);
 
     if (tile_desc != NULL) {
+        chk_redundant(state, REDUNDANT_SETTILESIZE,
+                      tile_desc->uls == uls && tile_desc->ult == ult && tile_desc->lrs == lrs && tile_desc->lrt == lrt,
+                      &state->known_tile_sizes, 1 << tile);
+
         tile_desc->uls = uls;
         tile_desc->ult = ult;
         tile_desc->lrs = lrs;
@@ -3379,6 +4409,8 @@ chk_SPBranchLessZraw(gfx_state_t *state)
 
     chk_Range(state, branchdl_phys, sizeof(Gfx));
 
+    vtx_cache_use(state, vtx);
+
     // Don't follow the depth branch ever
     if (state->options->all_depth_cull)
         return 0;
@@ -3398,16 +4430,20 @@ chk_SPBranchLessZraw(gfx_state_t *state)
 static int
 chk_SPClipRatio(gfx_state_t *state)
 {
+    int r = gfxd_arg_value(0)->i;
+
     // TODO
 
+    state->clip_ratio = r;
     return 0;
 }
 
 static int
-chk_fog(int fm, int fo)
+chk_fog(gfx_state_t *state, int fm, int fo)
 {
     // TODO
 
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3417,7 +4453,7 @@ chk_SPFogFactor(gfx_state_t *state)
     int fm = gfxd_arg_value(0)->i;
     int fo = gfxd_arg_value(1)->i;
 
-    return chk_fog(fm, fo);
+    return chk_fog(state, fm, fo);
 }
 
 static int
@@ -3429,7 +4465,7 @@ chk_SPFogPosition(gfx_state_t *state)
     int fm = 128000 / ((max) - (min));
     int fo = (500 - (min)) * 256 / ((max) - (min));
 
-    return chk_fog(fm, fo);
+    return chk_fog(state, fm, fo);
 }
 
 static int
@@ -3440,6 +4476,8 @@ chk_SPForceMatrix(gfx_state_t *state)
 
     chk_Range(state, mptr_phys, sizeof(Mtx));
 
+    state->mtx_gen++;
+
     // TODO
 
     return 0;
@@ -3448,6 +4486,8 @@ chk_SPForceMatrix(gfx_state_t *state)
 static int
 chk_SPInsertMatrix(gfx_state_t *state)
 {
+    state->mtx_gen++;
+
     // TODO
 
     return 0;
@@ -3522,6 +4562,7 @@ chk_SPLookAtX(gfx_state_t *state)
     uint32_t l_phys = segmented_to_physical(state, l);
 
     chk_Range(state, l_phys, sizeof(Light));
+    state->mtx_gen++;
 
     return 0;
 }
@@ -3533,6 +4574,7 @@ chk_SPLookAtY(gfx_state_t *state)
     uint32_t l_phys = segmented_to_physical(state, l);
 
     chk_Range(state, l_phys, sizeof(Light));
+    state->mtx_gen++;
 
     return 0;
 }
@@ -3544,6 +4586,7 @@ chk_SPLookAt(gfx_state_t *state)
     uint32_t l_phys = segmented_to_physical(state, l);
 
     chk_Range(state, l_phys, sizeof(LookAt));
+    state->mtx_gen++;
 
     return 0;
 }
@@ -3557,6 +4600,10 @@ chk_SPModifyVertex(gfx_state_t *state)
 
     ARG_CHECK(state, vtx < VTX_CACHE_SIZE, GW_MODIFYVTX_OOB);
 
+    // The vertex no longer matches what was loaded
+    if ((unsigned)vtx < VTX_CACHE_SIZE)
+        state->vtx_src[vtx] = VTX_SRC_NONE;
+
     // TODO
 
     return 0;
@@ -3579,6 +4626,12 @@ chk_popmtx(gfx_state_t *state, int param, int num)
 
     state->matrix_stack_depth -= num;
     obstack_pop(&state->mtx_stack, num);
+    state->mtx_gen++;
+    state->work.rsp_cycles += COST_RSP_MTX_POP;
+
+    // The combined matrix is recomputed from the new top of the stack
+    if (state->matrix_projection_set && state->matrix_modelview_set && state->mtx_stack.count != 0)
+        mtxf_mtxf_mul(&state->mvp_mtx, (MtxF *)obstack_peek(&state->mtx_stack), &state->projection_mtx);
     return 0;
 }
 
@@ -3604,6 +4657,8 @@ chk_SPSetLights1(gfx_state_t *state)
 {
     // TODO
 
+    state->num_lights = 1;
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3612,6 +4667,8 @@ chk_SPSetLights2(gfx_state_t *state)
 {
     // TODO
 
+    state->num_lights = 2;
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3620,6 +4677,8 @@ chk_SPSetLights3(gfx_state_t *state)
 {
     // TODO
 
+    state->num_lights = 3;
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3628,6 +4687,8 @@ chk_SPSetLights4(gfx_state_t *state)
 {
     // TODO
 
+    state->num_lights = 4;
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3636,6 +4697,8 @@ chk_SPSetLights5(gfx_state_t *state)
 {
     // TODO
 
+    state->num_lights = 5;
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3644,6 +4707,8 @@ chk_SPSetLights6(gfx_state_t *state)
 {
     // TODO
 
+    state->num_lights = 6;
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3652,14 +4717,20 @@ chk_SPSetLights7(gfx_state_t *state)
 {
     // TODO
 
+    state->num_lights = 7;
+    state->mtx_gen++;
     return 0;
 }
 
 static int
 chk_SPNumLights(gfx_state_t *state)
 {
+    int n = gfxd_arg_value(0)->i;
+
     // TODO
 
+    state->num_lights = n;
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3668,6 +4739,7 @@ chk_SPLight(gfx_state_t *state)
 {
     // TODO
 
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3676,6 +4748,7 @@ chk_SPLightColor(gfx_state_t *state)
 {
     // TODO
 
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3692,6 +4765,11 @@ chk_SPTexture(gfx_state_t *state)
 
     ARG_CHECK(state, tile_desc != NULL, GW_TILEDESC_BAD, tile);
 
+    chk_redundant(state, REDUNDANT_TEXTURE,
+                  tile == state->render_tile && on == state->render_tile_on && level == state->render_tile_level &&
+                      sc == state->tex_s_scale && tc == state->tex_t_scale,
+                  &state->known_state, (tile_desc != NULL) << REDUNDANT_TEXTURE);
+
     state->render_tile = tile;
 
     if (tile_desc != NULL) {
@@ -3722,6 +4800,8 @@ chk_SPTextureRectangle(gfx_state_t *state)
 
     // TODO generate rdp texrect command
 
+    draw_rect(state, ulx, uly, lrx, lry);
+
     return chk_render_primitive(state, PRIM_TYPE_TEXRECT, tile);
 }
 
@@ -3742,6 +4822,8 @@ chk_SPTextureRectangleFlip(gfx_state_t *state)
 
     // TODO generate rdp texrect command
 
+    draw_rect(state, ulx, uly, lrx, lry);
+
     return chk_render_primitive(state, PRIM_TYPE_TEXRECT, tile);
 }
 
@@ -3782,6 +4864,8 @@ chk_MoveWd(gfx_state_t *state)
 {
     // TODO
 
+    // May have written lights or matrices
+    state->mtx_gen++;
     return 0;
 }
 
@@ -3790,6 +4874,8 @@ chk_MoveMem(gfx_state_t *state)
 {
     // TODO
 
+    // May have written lights or matrices
+    state->mtx_gen++;
     return 0;
 }
 
@@ -4144,10 +5230,27 @@ chk_LTB(gfx_state_t *state, uint32_t timg, int fmt, int siz, int width, int heig
     //           "The width-height combination for LoadTextureBlock will cause corruption due to dxt imprecision, "
     //           "a width of %d may only have at most %d texture lines, this has %d", width, mlines, height);
 
-    if (state->options->print_textures) {
-        tile_descriptor_t *tile_desc = get_tile_desc(state, pal);
-        if (tile_desc != NULL)
-            draw_last_timg(state, timg, fmt, siz, height, width, tile_desc->tmem, pal, tile_desc->lrs);
+    if (state->options->print_textures || state->options->report_dup_textures) {
+        TexKey key = {
+            .timg      = segment_resolve(state, timg),
+            .fmt       = fmt,
+            .siz       = siz,
+            .width     = width,
+            .height    = height,
+            .tlut      = 0,
+            .tlut_type = G_TT_NONE,
+        };
+        if (fmt == G_IM_FMT_CI) {
+            key.tlut      = state->last_tlut.addr;
+            key.tlut_type = state->othermode_hi & MDMASK(TEXTLUT);
+        }
+
+        TexEntry *tex = texcache_lookup(&state->texcache, state->rdram, &key, state->options->print_textures);
+        if (tex != NULL && state->options->print_textures) {
+            draw_last_timg(state->print_out, state, tex);
+            // The disassembly is written to the file descriptor directly, keep the preview in order with it
+            fflush(state->print_out);
+        }
     }
 
     return 0;
@@ -4475,6 +5578,215 @@ arg_handler(int arg_num)
     }
 }
 
+/**************************************************************************
+ *  DISP Profile
+ */
+
+/**
+ * Returns whether any of the requested reports break work down by DISP site.
+ */
+static bool
+disp_profiling(const gbd_options_t *opts)
+{
+    return opts->profile_disp || opts->redundant_report || opts->tri_report;
+}
+
+/**
+ * Returns the profile entry for the OpenDisp at `str_addr` and `line_no`, creating it on first use.
+ */
+static DispSite *
+disp_site_get(gfx_state_t *state, uint32_t str_addr, int line_no)
+{
+    uint64_t  key  = ((uint64_t)str_addr << 32) | (uint32_t)line_no;
+    DispSite *site = hashmap_get(&state->disp_sites, key);
+
+    if (site == NULL) {
+        site = arena_alloc(&state->arena, sizeof(DispSite));
+        if (site == NULL)
+            return &state->no_disp_site;
+
+        *site = (DispSite){
+            .str_addr = str_addr,
+            .line_no  = line_no,
+        };
+        hashmap_put(&state->disp_sites, key, site);
+        obstack_push(&state->disp_site_list, &site);
+    }
+    return site;
+}
+
+/**
+ * Returns the profile entry work is currently attributed to, that of the innermost open DISP.
+ */
+static DispSite *
+disp_site_cur(gfx_state_t *state)
+{
+    if (state->disp_stack.count == 0)
+        return &state->no_disp_site;
+
+    DispEntry *disp_ent = (DispEntry *)obstack_peek(&state->disp_stack);
+    return (disp_ent->site != NULL) ? disp_ent->site : &state->no_disp_site;
+}
+
+/**
+ * Returns all work counters as of now. Command dispatch and texture loads are costed here from the command count and
+ * the TMEM statistics rather than as they happen.
+ */
+static WorkCounters
+work_snapshot(gfx_state_t *state)
+{
+    WorkCounters work    = state->work;
+    uint64_t     n_loads = 0;
+
+    work.n_cmds    = state->n_gfx;
+    work.tex_bytes = 0;
+    for (int i = 0; i < TMEM_LOAD_TYPE_MAX; i++) {
+        work.tex_bytes += state->tmem.stats.bytes[i];
+        n_loads += state->tmem.stats.n_loads[i];
+    }
+    work.rsp_cycles += (uint64_t)work.n_cmds * COST_RSP_CMD;
+    work.rdp_cycles += n_loads * COST_RDP_LOAD + work.tex_bytes / 8;
+    return work;
+}
+
+static void
+work_add_delta(WorkCounters *work, const WorkCounters *before, const WorkCounters *after)
+{
+    work->n_cmds += after->n_cmds - before->n_cmds;
+    work->n_tris += after->n_tris - before->n_tris;
+    work->n_vtx += after->n_vtx - before->n_vtx;
+    work->n_mtx += after->n_mtx - before->n_mtx;
+    work->tex_bytes += after->tex_bytes - before->tex_bytes;
+    work->rsp_cycles += after->rsp_cycles - before->rsp_cycles;
+    work->rdp_cycles += after->rdp_cycles - before->rdp_cycles;
+    work->n_redundant += after->n_redundant - before->n_redundant;
+    work->redundant_bytes += after->redundant_bytes - before->redundant_bytes;
+    for (int i = 0; i < TRI_CLASS_MAX; i++)
+        work->n_tri_class[i] += after->n_tri_class[i] - before->n_tri_class[i];
+}
+
+/**************************************************************************
+ *  Folded Stacks
+ */
+
+/**
+ * Returns the folded stack entry for the current display list and DISP call stack, creating it on first use.
+ */
+static FoldedStack *
+folded_stack_cur(gfx_state_t *state)
+{
+    uint64_t   frames[FOLDED_MAX_DEPTH];
+    int        depth  = 0;
+    DispEntry *disp   = (DispEntry *)state->disp_stack.start;
+    size_t     n_disp = state->disp_stack.count;
+    size_t     d      = 0;
+
+    // Each display list is followed by the DISPs opened in it
+    for (int level = -1; level <= state->dl_stack_top && depth < FOLDED_MAX_DEPTH; level++) {
+        frames[depth++] = (level == -1) ? state->root_dl : segmented_to_physical(state, state->dl_stack_pc[level]);
+
+        for (; d < n_disp && disp[d].dl_stack_top <= level && depth < FOLDED_MAX_DEPTH; d++) {
+            if (disp[d].dl_stack_top == level)
+                frames[depth++] = FOLDED_FRAME_DISP | ((uint64_t)disp[d].str_addr << 32) | (uint32_t)disp[d].line_no;
+        }
+    }
+
+    uint64_t     hash  = xxh64(frames, depth * sizeof(uint64_t), 0);
+    FoldedStack *stack = hashmap_get(&state->folded_stacks, hash);
+
+    if (stack == NULL) {
+        stack = arena_alloc(&state->arena, sizeof(FoldedStack) + depth * sizeof(uint64_t));
+        if (stack == NULL)
+            return NULL;
+
+        stack->depth  = depth;
+        stack->weight = 0;
+        memcpy(stack->frames, frames, depth * sizeof(uint64_t));
+        hashmap_put(&state->folded_stacks, hash, stack);
+        obstack_push(&state->folded_list, &stack);
+    }
+    return stack;
+}
+
+static uint64_t
+folded_weight(gfx_state_t *state, const WorkCounters *before, const WorkCounters *after)
+{
+    switch (state->options->folded_weight) {
+        case GBD_FOLDED_TRIS:
+            return after->n_tris - before->n_tris;
+        case GBD_FOLDED_VERTS:
+            return after->n_vtx - before->n_vtx;
+        case GBD_FOLDED_RSP_CYCLES:
+            return after->rsp_cycles - before->rsp_cycles;
+        case GBD_FOLDED_RDP_CYCLES:
+            return after->rdp_cycles - before->rdp_cycles;
+        default:
+            return after->n_cmds - before->n_cmds;
+    }
+}
+
+/**
+ * Prints the name of a display list, its symbol if there is one at or shortly before it, else its address.
+ */
+static void
+print_dl_name(FILE *out, gfx_state_t *state, uint32_t phys)
+{
+    uint32_t            vaddr = phys | 0x80000000;
+    const gbd_symbol_t *sym   = NULL;
+
+    if (state->options->symbols != NULL)
+        sym = gbd_symbols_lookup(state->options->symbols, vaddr);
+
+    if (sym != NULL && sym->addr == vaddr)
+        fprintf(out, "%s", sym->name);
+    else if (sym != NULL && vaddr - sym->addr < 0x1000)
+        fprintf(out, "%s+0x%X", sym->name, vaddr - sym->addr);
+    else
+        fprintf(out, "0x%08X", vaddr);
+}
+
+/**
+ * Writes one `frame;frame;frame weight` line per distinct call stack, the input format of flamegraph tools.
+ */
+static void
+write_folded_stacks(FILE *print_out, gfx_state_t *state)
+{
+    FILE *out = fopen(state->options->folded_path, "w");
+
+    if (out == NULL) {
+        fprintf(print_out, ERROR_COLOR "FAILED to open %s for writing" VT_RST "\n", state->options->folded_path);
+        return;
+    }
+
+    OBSTACK_FOR_EACH_ELEMENT(&state->folded_list, stackp, FoldedStack **) {
+        FoldedStack *stack = *stackp;
+
+        if (stack->weight == 0)
+            continue;
+
+        for (int i = 0; i < stack->depth; i++) {
+            uint64_t frame = stack->frames[i];
+
+            if (i != 0)
+                fputc(';', out);
+
+            if (frame & FOLDED_FRAME_DISP) {
+                uint32_t     str_addr = (frame & ~FOLDED_FRAME_DISP) >> 32;
+                InternedStr *file     = intern_string(state, str_addr);
+
+                if (file != NULL)
+                    fprintf(out, "%s:%d", file->str, (int)(uint32_t)frame);
+                else
+                    fprintf(out, "0x%08X:%d", str_addr, (int)(uint32_t)frame);
+            } else {
+                print_dl_name(out, state, frame);
+            }
+        }
+        fprintf(out, " %" PRIu64 "\n", stack->weight);
+    }
+    fclose(out);
+}
+
 static void
 decode_noop_cmd(gfx_state_t *state)
 {
@@ -4530,6 +5842,8 @@ decode_noop_cmd(gfx_state_t *state)
                     .line_no      = noop_data1->u,
                     .dl_stack_top = state->dl_stack_top,
                 };
+                if (disp_profiling(state->options) || state->options->folded_path != NULL)
+                    disp_ent.site = disp_site_get(state, disp_ent.str_addr, disp_ent.line_no);
                 obstack_push(&state->disp_stack, &disp_ent);
             }
             break;
@@ -4610,6 +5924,16 @@ do_single_gfx(void)
         gfxd_puts(",\n");
     }
 
+    state->opt_cur = (state->opt_first >= 0) ? state->opt_first + state->opt_pkt++ : -1;
+
+    OptCmd *cmd = opt_cmd_cur(state);
+    if (cmd != NULL && state->next_ucode == gfxd_f3dex2) {
+        if (m_id == gfxd_SP1Triangle)
+            cmd->kind = OPT_CMD_TRI1;
+        else if (m_id == gfxd_SPVertex)
+            cmd->kind = OPT_CMD_VTX;
+    }
+
     chk_fn fn = chk_tbl[m_id];
     if (fn != NULL)
         fn(state);
@@ -4641,7 +5965,21 @@ macro_fn(void)
     macro_print();
     gfxd_puts(",\n");
 
-    int n_pkt = gfxd_macro_packets();
+    int      n_pkt    = gfxd_macro_packets();
+    uint32_t gfx_addr = state->gfx_addr;
+
+    if (state->options->optimize_path != NULL)
+        opt_record(state, n_pkt);
+
+    state->n_gfx_words += n_pkt;
+    if (state->options->task_stats) {
+        if (gfx_addr != state->gfx_run.end) {
+            if (state->gfx_run.end != state->gfx_run.start)
+                obstack_push(&state->gfx_runs, &state->gfx_run);
+            state->gfx_run.start = gfx_addr;
+        }
+        state->gfx_run.end = gfx_addr + n_pkt * sizeof(Gfx);
+    }
 
     if (n_pkt == 1) {
         // single-packet
@@ -4664,6 +6002,12 @@ macro_fn(void)
         state->multi_packet = false;
     }
 
+    // Calls push the display list stack, anything else that moves on from the root display list is a branch
+    if (state->opt_first >= 0 && state->dl_stack_top != -1)
+        opt_call(state);
+    else if (state->opt_first >= 0 && state->gfx_addr != gfx_addr)
+        state->opt_branched = true;
+
     state->last_gfx_pkt_count = n_pkt;
     return 1; /* Non-zero to step one (possibly compound) macro at a time */
 }
@@ -4688,28 +6032,781 @@ input_callback(void *buf, int count)
     return state->rdram->read(buf, 1, count);
 }
 
+static void
+free_strings(gfx_state_t *state)
+{
+    // The strings themselves are owned by the arena, the iconv descriptor is kept for the next analysis
+    hashmap_destroy(&state->strings);
+}
+
 /**************************************************************************
- *  Main
+ *  Texture Report
  */
 
-int
-analyze_gbi(FILE *print_out, gfx_ucode_registry_t *ucodes, gbd_options_t *opts, rdram_interface_t *rdram,
-            const void *rdram_arg, struct start_location_info *start_location)
+static int
+tex_entry_cmp(const void *a, const void *b)
 {
-    gfx_state_t state = {
-        .task_done        = false,
-        .pipeline_crashed = false,
-        .multi_packet     = false,
-
-        .last_gfx_pkt_count = 1,
+    const TexEntry *tex_a = *(const TexEntry **)a;
+    const TexEntry *tex_b = *(const TexEntry **)b;
 
-        .segment_table[0]      = 0,
-        .segment_set_bits      = 1,
-        .matrix_stack_depth    = 0,
-        .matrix_projection_set = false,
-        .matrix_modelview_set  = false,
+    if (tex_a->content_hash != tex_b->content_hash)
+        return (tex_a->content_hash < tex_b->content_hash) ? -1 : 1;
+    if (tex_a->size != tex_b->size)
+        return (tex_a->size < tex_b->size) ? -1 : 1;
+    if (tex_a->key.timg != tex_b->key.timg)
+        return (tex_a->key.timg < tex_b->key.timg) ? -1 : 1;
+    return 0;
+}
 
-        .ex3_mat_cull_mode = 0,
+/**
+ * Lists textures whose contents are identical but which were loaded from more than one RDRAM address.
+ */
+static void
+print_dup_textures(FILE *print_out, TexCache *cache)
+{
+    size_t     n_tex = cache->entries.count;
+    ArenaMark  mark  = arena_mark(cache->arena);
+    TexEntry **sorted;
+    uint32_t   total_wasted = 0;
+    int        n_dups       = 0;
+
+    fprintf(print_out, DIAG_COLOR "\nDuplicate Textures:\n" VT_RST);
+
+    if (n_tex == 0) {
+        fprintf(print_out, "    No textures loaded\n");
+        return;
+    }
+
+    sorted = arena_alloc(cache->arena, n_tex * sizeof(TexEntry *));
+    if (sorted == NULL) {
+        fprintf(print_out, ERROR_COLOR "FAILED to allocate texture report" VT_RST "\n");
+        return;
+    }
+    memcpy(sorted, cache->entries.start, n_tex * sizeof(TexEntry *));
+    qsort(sorted, n_tex, sizeof(TexEntry *), tex_entry_cmp);
+
+    for (size_t i = 0; i < n_tex;) {
+        size_t   j;
+        int      n_addrs = 1;
+        uint32_t size    = sorted[i]->size;
+
+        // Find the run of entries with the same contents, counting distinct addresses
+        for (j = i + 1; j < n_tex && sorted[j]->content_hash == sorted[i]->content_hash && sorted[j]->size == size;
+             j++) {
+            if (sorted[j]->key.timg != sorted[j - 1]->key.timg)
+                n_addrs++;
+        }
+
+        if (sorted[i]->status != TEX_READ_ERROR && n_addrs > 1) {
+            uint32_t wasted = size * (n_addrs - 1);
+
+            fprintf(print_out, "    %016" PRIX64 " (0x%X bytes, 0x%X wasted):", sorted[i]->content_hash, size, wasted);
+            for (size_t k = i; k < j; k++) {
+                if (k == i || sorted[k]->key.timg != sorted[k - 1]->key.timg)
+                    fprintf(print_out, " 0x%08X", sorted[k]->key.timg);
+            }
+            fprintf(print_out, "\n");
+
+            total_wasted += wasted;
+            n_dups++;
+        }
+        i = j;
+    }
+    arena_release(cache->arena, mark);
+
+    if (n_dups == 0)
+        fprintf(print_out, "    None\n");
+    else
+        fprintf(print_out, "    %d duplicated texture(s), 0x%X bytes of RDRAM wasted\n", n_dups, total_wasted);
+    fprintf(print_out, "    %d texture loads, %d unique\n", cache->n_hits + cache->n_misses, cache->n_misses);
+}
+
+static const char *
+tmem_load_type_str(enum tmem_load_type type)
+{
+    static const char *names[TMEM_LOAD_TYPE_MAX] = {
+        [TMEM_LOAD_BLOCK] = "LoadBlock",
+        [TMEM_LOAD_TILE]  = "LoadTile",
+        [TMEM_LOAD_TLUT]  = "LoadTLUT",
+    };
+    return names[type];
+}
+
+/**
+ * Summarizes texture load bandwidth and how much of TMEM primitives sampled over the task, and lists loads that only
+ * reloaded data that was still resident in TMEM.
+ */
+static void
+print_tmem_report(FILE *print_out, const TmemStats *stats, const ObStack *reloads)
+{
+    uint64_t total_bytes = 0;
+    int      total_loads = 0;
+
+    fprintf(print_out, DIAG_COLOR "\nTMEM Loads:\n" VT_RST);
+    for (int i = 0; i < TMEM_LOAD_TYPE_MAX; i++) {
+        fprintf(print_out, "    %-9s %6d loads, %8" PRIu64 " bytes\n", tmem_load_type_str(i), stats->n_loads[i],
+                stats->bytes[i]);
+        total_bytes += stats->bytes[i];
+        total_loads += stats->n_loads[i];
+    }
+    fprintf(print_out, "    %-9s %6d loads, %8" PRIu64 " bytes\n", "Total", total_loads, total_bytes);
+
+    if (stats->n_sampling != 0) {
+        // Only what the tile descriptors of each primitive sample counts as in use
+        fprintf(print_out, "    Peak TMEM in use:    %4d bytes (%.1f%%)\n", stats->peak_sampled * 8,
+                100.0f * stats->peak_sampled / TMEM_WORDS);
+        fprintf(print_out, "    Average TMEM in use: %4.0f bytes (%.1f%%) over %d textured primitives\n",
+                8.0f * stats->sampled_sum / stats->n_sampling,
+                100.0f * stats->sampled_sum / stats->n_sampling / TMEM_WORDS, stats->n_sampling);
+    }
+
+    fprintf(print_out, "    %d reloads of resident data, %" PRIu64 " bytes\n", stats->n_resident,
+            stats->resident_bytes);
+
+    OBSTACK_FOR_EACH_ELEMENT(reloads, reload, TmemReload *)
+    {
+        fprintf(print_out, "        command #%d: %s from 0x%08X\n", reload->cmd_num, tmem_load_type_str(reload->type),
+                reload->addr);
+    }
+}
+
+static int
+disp_site_cmp(const void *a, const void *b)
+{
+    const DispSite *site_a = *(const DispSite *const *)a;
+    const DispSite *site_b = *(const DispSite *const *)b;
+
+    // Most commands first
+    if (site_a->work.n_cmds != site_b->work.n_cmds)
+        return (site_a->work.n_cmds > site_b->work.n_cmds) ? -1 : 1;
+    if (site_a->str_addr != site_b->str_addr)
+        return (site_a->str_addr < site_b->str_addr) ? -1 : 1;
+    return site_a->line_no - site_b->line_no;
+}
+
+static void
+print_disp_site_name(FILE *print_out, gfx_state_t *state, const DispSite *site)
+{
+    InternedStr *file = (site == &state->no_disp_site) ? NULL : intern_string(state, site->str_addr);
+    if (site == &state->no_disp_site)
+        fprintf(print_out, "(outside of any OpenDisp)\n");
+    else if (file == NULL)
+        fprintf(print_out, "0x%08X:%d\n", site->str_addr, site->line_no);
+    else
+        fprintf(print_out, "%s:%d\n", file->str, site->line_no);
+}
+
+static void
+print_disp_site_row(FILE *print_out, gfx_state_t *state, const DispSite *site)
+{
+    fprintf(print_out, "    %7d %7d %7d %6d %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "  ", site->work.n_cmds,
+            site->work.n_tris, site->work.n_vtx, site->work.n_mtx, site->work.tex_bytes, site->work.rsp_cycles,
+            site->work.rdp_cycles);
+    print_disp_site_name(print_out, state, site);
+}
+
+/**
+ * Lists the work done in each OpenDisp/CloseDisp site, attributed to the innermost open DISP, most commands first.
+ */
+static void
+print_disp_profile(FILE *print_out, gfx_state_t *state)
+{
+    size_t     n_sites = state->disp_site_list.count;
+    ArenaMark  mark;
+    DispSite **sorted;
+
+    fprintf(print_out, DIAG_COLOR "\nDISP Profile:\n" VT_RST);
+    fprintf(print_out, "    %7s %7s %7s %6s %10s %10s %10s  %s\n", "Cmds", "Tris", "Verts", "Mtxs", "Tex bytes",
+            "RSP cycles", "RDP cycles", "Site");
+
+    if (n_sites != 0) {
+        sorted = arena_alloc(&state->arena, n_sites * sizeof(DispSite *));
+        if (sorted == NULL) {
+            fprintf(print_out, ERROR_COLOR "FAILED to allocate DISP profile" VT_RST "\n");
+            return;
+        }
+        memcpy(sorted, state->disp_site_list.start, n_sites * sizeof(DispSite *));
+        qsort(sorted, n_sites, sizeof(DispSite *), disp_site_cmp);
+
+        for (size_t i = 0; i < n_sites; i++)
+            print_disp_site_row(print_out, state, sorted[i]);
+        arena_release(&state->arena, mark);
+    }
+    if (state->no_disp_site.work.n_cmds != 0)
+        print_disp_site_row(print_out, state, &state->no_disp_site);
+}
+
+static uint64_t
+work_cycles(const WorkCounters *work)
+{
+    // The RSP and RDP run in parallel, whichever is busier bounds the time taken
+    return MAX(work->rsp_cycles, work->rdp_cycles);
+}
+
+static int
+dl_profile_cmp(const void *a, const void *b)
+{
+    const DlProfile *prof_a = *(const DlProfile *const *)a;
+    const DlProfile *prof_b = *(const DlProfile *const *)b;
+
+    // Most expensive first
+    if (work_cycles(&prof_a->total) != work_cycles(&prof_b->total))
+        return (work_cycles(&prof_a->total) > work_cycles(&prof_b->total)) ? -1 : 1;
+    return (prof_a->addr < prof_b->addr) ? -1 : (prof_a->addr > prof_b->addr);
+}
+
+/**
+ * Prints the estimated RSP and RDP cycles for the whole task and for each display list, most expensive first.
+ */
+static void
+print_cost_report(FILE *print_out, gfx_state_t *state, const WorkCounters *work)
+{
+    size_t      n_profs = state->dl_profile_list.count;
+    ArenaMark   mark    = arena_mark(&state->arena);
+    DlProfile **sorted;
+
+    fprintf(print_out, DIAG_COLOR "\nCost Estimate:\n" VT_RST);
+    fprintf(print_out, "    RSP: %10" PRIu64 " cycles (%.0f us)\n", work->rsp_cycles,
+            work->rsp_cycles / COST_CLOCK_MHZ);
+    fprintf(print_out, "    RDP: %10" PRIu64 " cycles (%.0f us)\n", work->rdp_cycles,
+            work->rdp_cycles / COST_CLOCK_MHZ);
+
+    if (n_profs == 0)
+        return;
+
+    sorted = arena_alloc(&state->arena, n_profs * sizeof(DlProfile *));
+    if (sorted == NULL) {
+        fprintf(print_out, ERROR_COLOR "FAILED to allocate cost report" VT_RST "\n");
+        return;
+    }
+    memcpy(sorted, state->dl_profile_list.start, n_profs * sizeof(DlProfile *));
+    qsort(sorted, n_profs, sizeof(DlProfile *), dl_profile_cmp);
+
+    fprintf(print_out, DIAG_COLOR "\n    Display lists:\n" VT_RST);
+    fprintf(print_out, "    %10s %10s %10s %10s  %s\n", "Self RSP", "Self RDP", "Total RSP", "Total RDP",
+            "Display list");
+    for (size_t i = 0; i < n_profs; i++) {
+        DlProfile *prof = sorted[i];
+
+        fprintf(print_out, "    %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "  ", prof->self.rsp_cycles,
+                prof->self.rdp_cycles, prof->total.rsp_cycles, prof->total.rdp_cycles);
+        print_dl_name(print_out, state, prof->addr);
+        fprintf(print_out, "\n");
+    }
+    arena_release(&state->arena, mark);
+}
+
+static int
+disp_site_redundant_cmp(const void *a, const void *b)
+{
+    const DispSite *site_a = *(const DispSite *const *)a;
+    const DispSite *site_b = *(const DispSite *const *)b;
+
+    // Most wasted bytes first
+    if (site_a->work.redundant_bytes != site_b->work.redundant_bytes)
+        return (site_a->work.redundant_bytes > site_b->work.redundant_bytes) ? -1 : 1;
+    return disp_site_cmp(a, b);
+}
+
+/**
+ * Lists the state changes that set a value already in place, by kind of command and by the DISP they were made in,
+ * along with the Gfx bytes they take and the RSP cycles spent processing them.
+ */
+static void
+print_redundant_report(FILE *print_out, gfx_state_t *state)
+{
+    size_t     n_sites = state->disp_site_list.count;
+    ArenaMark  mark;
+    DispSite **sorted;
+
+    fprintf(print_out, DIAG_COLOR "\nRedundant State Changes:\n" VT_RST);
+    fprintf(print_out, "    %-14s %7s %10s %10s\n", "Command", "Count", "Bytes", "RSP cycles");
+    for (int i = 0; i < REDUNDANT_KIND_MAX; i++) {
+        RedundantStats *stats = &state->redundant[i];
+
+        fprintf(print_out, "    %-14s %7d %10" PRIu64 " %10" PRIu64 "\n", redundant_kind_str(i), stats->count,
+                stats->bytes, (uint64_t)stats->count * COST_RSP_CMD);
+    }
+    fprintf(print_out, "    %-14s %7d %10" PRIu64 " %10" PRIu64 "\n", "Total", state->work.n_redundant,
+            state->work.redundant_bytes, (uint64_t)state->work.n_redundant * COST_RSP_CMD);
+
+    if (state->work.n_redundant == 0)
+        return;
+
+    mark   = arena_mark(&state->arena);
+    sorted = arena_alloc(&state->arena, (n_sites + 1) * sizeof(DispSite *));
+    if (sorted == NULL) {
+        fprintf(print_out, ERROR_COLOR "FAILED to allocate redundant state report" VT_RST "\n");
+        arena_release(&state->arena, mark);
+        return;
+    }
+    memcpy(sorted, state->disp_site_list.start, n_sites * sizeof(DispSite *));
+    qsort(sorted, n_sites, sizeof(DispSite *), disp_site_redundant_cmp);
+    // Commands outside of any DISP are listed last
+    sorted[n_sites] = &state->no_disp_site;
+
+    fprintf(print_out, DIAG_COLOR "\n    By DISP:\n" VT_RST);
+    fprintf(print_out, "    %7s %10s %10s  %s\n", "Count", "Bytes", "RSP cycles", "Site");
+
+    for (size_t i = 0; i <= n_sites; i++) {
+        DispSite *site = sorted[i];
+
+        if (site->work.n_redundant == 0)
+            continue;
+
+        fprintf(print_out, "    %7d %10" PRIu64 " %10" PRIu64 "  ", site->work.n_redundant, site->work.redundant_bytes,
+                (uint64_t)site->work.n_redundant * COST_RSP_CMD);
+        print_disp_site_name(print_out, state, site);
+    }
+    arena_release(&state->arena, mark);
+}
+
+static int
+dl_profile_vtx_cmp(const void *a, const void *b)
+{
+    const DlProfile *prof_a = *(const DlProfile *const *)a;
+    const DlProfile *prof_b = *(const DlProfile *const *)b;
+    int              waste_a = prof_a->vtx.n_unused + prof_a->vtx.n_reloaded;
+    int              waste_b = prof_b->vtx.n_unused + prof_b->vtx.n_reloaded;
+
+    // Most wasted vertices first
+    if (waste_a != waste_b)
+        return (waste_a > waste_b) ? -1 : 1;
+    if (prof_a->vtx.n_loaded != prof_b->vtx.n_loaded)
+        return (prof_a->vtx.n_loaded > prof_b->vtx.n_loaded) ? -1 : 1;
+    return (prof_a->addr < prof_b->addr) ? -1 : (prof_a->addr > prof_b->addr);
+}
+
+static void
+print_vtx_cache_row(FILE *print_out, const VtxCacheStats *stats)
+{
+    fprintf(print_out, "    %7d %7d %8d %7d ", stats->n_loaded, stats->n_unused, stats->n_reloaded, stats->n_tris);
+    if (stats->n_loaded != 0)
+        fprintf(print_out, "%8.2f  ", (double)stats->n_tris / stats->n_loaded);
+    else
+        fprintf(print_out, "%8s  ", "-");
+}
+
+/**
+ * Prints how well the vertices loaded into the vertex cache were used, for the whole task and for each display list
+ * that loaded vertices or drew triangles, most wasted vertices first.
+ */
+static void
+print_vtx_cache_report(FILE *print_out, gfx_state_t *state)
+{
+    size_t         n_profs = state->dl_profile_list.count;
+    ArenaMark      mark    = arena_mark(&state->arena);
+    VtxCacheStats *stats   = &state->vtx_stats;
+    DlProfile    **sorted;
+
+    fprintf(print_out, DIAG_COLOR "\nVertex Cache:\n" VT_RST);
+    fprintf(print_out, "    %7s %7s %8s %7s %8s  %s\n", "Loaded", "Unused", "Reloaded", "Tris", "Tris/vtx",
+            "Display list");
+    print_vtx_cache_row(print_out, stats);
+    fprintf(print_out, "(all)\n");
+
+    if (n_profs == 0)
+        return;
+
+    sorted = arena_alloc(&state->arena, n_profs * sizeof(DlProfile *));
+    if (sorted == NULL) {
+        fprintf(print_out, ERROR_COLOR "FAILED to allocate vertex cache report" VT_RST "\n");
+        return;
+    }
+    memcpy(sorted, state->dl_profile_list.start, n_profs * sizeof(DlProfile *));
+    qsort(sorted, n_profs, sizeof(DlProfile *), dl_profile_vtx_cmp);
+
+    for (size_t i = 0; i < n_profs; i++) {
+        DlProfile *prof = sorted[i];
+
+        if (prof->vtx.n_loaded == 0 && prof->vtx.n_tris == 0)
+            continue;
+
+        print_vtx_cache_row(print_out, &prof->vtx);
+        print_dl_name(print_out, state, prof->addr);
+        fprintf(print_out, "\n");
+    }
+    arena_release(&state->arena, mark);
+}
+
+static int
+material_saved(const MaterialStats *stats)
+{
+    return (stats->n_changes - stats->n_changes_sorted) + (stats->n_loads - stats->n_loads_sorted);
+}
+
+static int
+dl_profile_mat_cmp(const void *a, const void *b)
+{
+    const DlProfile *prof_a = *(const DlProfile *const *)a;
+    const DlProfile *prof_b = *(const DlProfile *const *)b;
+
+    // Most state changes and loads saved first
+    if (material_saved(&prof_a->mat) != material_saved(&prof_b->mat))
+        return (material_saved(&prof_a->mat) > material_saved(&prof_b->mat)) ? -1 : 1;
+    if (prof_a->mat.n_batches != prof_b->mat.n_batches)
+        return (prof_a->mat.n_batches > prof_b->mat.n_batches) ? -1 : 1;
+    return (prof_a->addr < prof_b->addr) ? -1 : (prof_a->addr > prof_b->addr);
+}
+
+static void
+print_material_row(FILE *print_out, const MaterialStats *stats)
+{
+    fprintf(print_out, "    %7d %7d %7d %7d %7d  ", stats->n_batches, stats->n_changes, stats->n_changes_sorted,
+            stats->n_loads, stats->n_loads_sorted);
+}
+
+/**
+ * Prints the state changes and texture loads needed between batches as drawn, against what they would be if the
+ * batches that can be drawn in any order were sorted by material, for the whole task and for each display list that
+ * drew anything, most saved first.
+ */
+static void
+print_material_report(FILE *print_out, gfx_state_t *state)
+{
+    size_t         n_profs = state->dl_profile_list.count;
+    ArenaMark      mark    = arena_mark(&state->arena);
+    MaterialStats *stats   = &state->mat_stats;
+    DlProfile    **sorted;
+
+    fprintf(print_out, DIAG_COLOR "\nMaterial Sorting:\n" VT_RST);
+    fprintf(print_out, "    %7s %7s %7s %7s %7s  %s\n", "Batches", "Changes", "Sorted", "Loads", "Sorted",
+            "Display list");
+    print_material_row(print_out, stats);
+    fprintf(print_out, "(all)\n");
+
+    if (n_profs == 0)
+        return;
+
+    sorted = arena_alloc(&state->arena, n_profs * sizeof(DlProfile *));
+    if (sorted == NULL) {
+        fprintf(print_out, ERROR_COLOR "FAILED to allocate material report" VT_RST "\n");
+        return;
+    }
+    memcpy(sorted, state->dl_profile_list.start, n_profs * sizeof(DlProfile *));
+    qsort(sorted, n_profs, sizeof(DlProfile *), dl_profile_mat_cmp);
+
+    for (size_t i = 0; i < n_profs; i++) {
+        DlProfile *prof = sorted[i];
+
+        if (prof->mat.n_batches == 0)
+            continue;
+
+        print_material_row(print_out, &prof->mat);
+        print_dl_name(print_out, state, prof->addr);
+        fprintf(print_out, "\n");
+    }
+    arena_release(&state->arena, mark);
+}
+
+static const char *
+tri_class_str(enum tri_class class)
+{
+    static const char *names[] = {
+        [TRI_DRAWN] = "Drawn", [TRI_CULLED] = "Culled", [TRI_OFFSCREEN] = "Offscreen",
+        [TRI_TINY] = "Tiny",   [TRI_CLIPPED] = "Clipped",
+    };
+    return names[class];
+}
+
+static int
+tri_wasted(const WorkCounters *work)
+{
+    return work->n_tri_class[TRI_CULLED] + work->n_tri_class[TRI_OFFSCREEN] + work->n_tri_class[TRI_TINY] +
+           work->n_tri_class[TRI_CLIPPED];
+}
+
+static void
+print_tri_class_row(FILE *print_out, const WorkCounters *work)
+{
+    fprintf(print_out, "   ");
+    for (int i = 0; i < TRI_CLASS_MAX; i++)
+        fprintf(print_out, " %9d", work->n_tri_class[i]);
+    fprintf(print_out, "  ");
+}
+
+static int
+dl_profile_tri_cmp(const void *a, const void *b)
+{
+    const DlProfile *prof_a = *(const DlProfile *const *)a;
+    const DlProfile *prof_b = *(const DlProfile *const *)b;
+
+    // Most wasted triangles first
+    if (tri_wasted(&prof_a->self) != tri_wasted(&prof_b->self))
+        return (tri_wasted(&prof_a->self) > tri_wasted(&prof_b->self)) ? -1 : 1;
+    return (prof_a->addr < prof_b->addr) ? -1 : (prof_a->addr > prof_b->addr);
+}
+
+static int
+disp_site_tri_cmp(const void *a, const void *b)
+{
+    const DispSite *site_a = *(const DispSite *const *)a;
+    const DispSite *site_b = *(const DispSite *const *)b;
+
+    if (tri_wasted(&site_a->work) != tri_wasted(&site_b->work))
+        return (tri_wasted(&site_a->work) > tri_wasted(&site_b->work)) ? -1 : 1;
+    return disp_site_cmp(a, b);
+}
+
+/**
+ * Prints how many triangles were drawn and how many were culled, entirely off-screen, smaller than a pixel or in need
+ * of clipping, for the whole task, for each display list (not including those it calls) and for each DISP site. Lists
+ * with the most wasted triangles come first.
+ */
+static void
+print_tri_report(FILE *print_out, gfx_state_t *state)
+{
+    size_t      n_profs = state->dl_profile_list.count;
+    size_t      n_sites = state->disp_site_list.count;
+    ArenaMark   mark    = arena_mark(&state->arena);
+    DlProfile **profs   = arena_alloc(&state->arena, (n_profs + 1) * sizeof(DlProfile *));
+    DispSite  **sites   = arena_alloc(&state->arena, (n_sites + 1) * sizeof(DispSite *));
+
+    fprintf(print_out, DIAG_COLOR "\nTriangle Classes:\n" VT_RST "   ");
+    for (int i = 0; i < TRI_CLASS_MAX; i++)
+        fprintf(print_out, " %9s", tri_class_str(i));
+    fprintf(print_out, "\n");
+    print_tri_class_row(print_out, &state->work);
+    fprintf(print_out, "(all)\n");
+
+    if (profs == NULL || sites == NULL) {
+        fprintf(print_out, ERROR_COLOR "FAILED to allocate triangle report" VT_RST "\n");
+        arena_release(&state->arena, mark);
+        return;
+    }
+
+    memcpy(profs, state->dl_profile_list.start, n_profs * sizeof(DlProfile *));
+    qsort(profs, n_profs, sizeof(DlProfile *), dl_profile_tri_cmp);
+
+    fprintf(print_out, DIAG_COLOR "\n    By display list:\n" VT_RST);
+    for (size_t i = 0; i < n_profs; i++) {
+        if (profs[i]->self.n_tris == 0)
+            continue;
+
+        print_tri_class_row(print_out, &profs[i]->self);
+        print_dl_name(print_out, state, profs[i]->addr);
+        fprintf(print_out, "\n");
+    }
+
+    memcpy(sites, state->disp_site_list.start, n_sites * sizeof(DispSite *));
+    qsort(sites, n_sites, sizeof(DispSite *), disp_site_tri_cmp);
+    sites[n_sites] = &state->no_disp_site;
+
+    fprintf(print_out, DIAG_COLOR "\n    By DISP:\n" VT_RST);
+    for (size_t i = 0; i <= n_sites; i++) {
+        if (sites[i]->work.n_tris == 0)
+            continue;
+
+        print_tri_class_row(print_out, &sites[i]->work);
+        print_disp_site_name(print_out, state, sites[i]);
+    }
+    arena_release(&state->arena, mark);
+}
+
+/**
+ * Prints the pixels drawn in each cycle type and the overdraw of each color image, and writes the heatmap of the color
+ * image drawn to the most.
+ */
+static void
+print_overdraw(FILE *print_out, gfx_state_t *state)
+{
+    static const char *cycle_type_names[] = { "1CYCLE", "2CYCLE", "COPY", "FILL" };
+    Raster            *most               = NULL;
+
+    fprintf(print_out, DIAG_COLOR "\nOverdraw:\n" VT_RST);
+    for (size_t i = 0; i < ARRAY_COUNT(cycle_type_names); i++)
+        fprintf(print_out, "    %-7s %10" PRIu64 " pixels\n", cycle_type_names[i], state->pixels_drawn[i]);
+
+    if (state->n_tris_near != 0)
+        fprintf(print_out, "    %d triangles crossing the near plane were not rasterized\n", state->n_tris_near);
+
+    OBSTACK_FOR_EACH_ELEMENT(&state->raster_list, rp, Raster **)
+    {
+        Raster  *r       = *rp;
+        uint64_t covered = raster_covered(r);
+
+        fprintf(print_out, "    Color image 0x%08X (%d wide): %" PRIu64 " pixels drawn, %" PRIu64 " covered", r->cimg,
+                r->width, r->pixels, covered);
+        if (covered != 0)
+            fprintf(print_out, ", %.2fx overdraw", (double)r->pixels / covered);
+        fprintf(print_out, "\n");
+
+        if (most == NULL || r->pixels > most->pixels)
+            most = r;
+    }
+
+    if (most == NULL) {
+        fprintf(print_out, "    Nothing was drawn, no heatmap written\n");
+    } else if (raster_write_ppm(most, state->options->overdraw_path) != 0) {
+        fprintf(print_out, ERROR_COLOR "FAILED to write %s" VT_RST "\n", state->options->overdraw_path);
+    } else {
+        fprintf(print_out, "    Wrote heatmap of 0x%08X to %s\n", most->cimg, state->options->overdraw_path);
+    }
+}
+
+static int
+addr_range_cmp(const void *a, const void *b)
+{
+    const AddrRange *range_a = a;
+    const AddrRange *range_b = b;
+
+    return (range_a->start < range_b->start) ? -1 : (range_a->start > range_b->start);
+}
+
+/**
+ * Sorts `n` ranges and merges those that overlap or touch, in place. Returns the number of ranges left.
+ */
+static size_t
+addr_ranges_merge(AddrRange *ranges, size_t n)
+{
+    size_t n_out = 0;
+
+    qsort(ranges, n, sizeof(AddrRange), addr_range_cmp);
+
+    for (size_t i = 0; i < n; i++) {
+        if (n_out != 0 && ranges[i].start <= ranges[n_out - 1].end)
+            ranges[n_out - 1].end = MAX(ranges[n_out - 1].end, ranges[i].end);
+        else
+            ranges[n_out++] = ranges[i];
+    }
+    return n_out;
+}
+
+static uint64_t
+addr_ranges_size(const AddrRange *ranges, size_t n)
+{
+    uint64_t size = 0;
+
+    for (size_t i = 0; i < n; i++)
+        size += ranges[i].end - ranges[i].start;
+    return size;
+}
+
+/**
+ * Prints how deep the display list and matrix stacks went, how much was executed and from where, and if the bounds of
+ * the gfx pool are known, how much of it the task referenced, counting both display lists and the data they use.
+ */
+static void
+print_task_stats(FILE *print_out, gfx_state_t *state)
+{
+    uint32_t pool_start = state->options->pool_start;
+    uint32_t pool_end   = state->options->pool_end;
+
+    if (state->gfx_run.end != state->gfx_run.start)
+        obstack_push(&state->gfx_runs, &state->gfx_run);
+
+    size_t   n_runs   = addr_ranges_merge(state->gfx_runs.start, state->gfx_runs.count);
+    uint64_t dl_bytes = addr_ranges_size(state->gfx_runs.start, n_runs);
+
+    fprintf(print_out, DIAG_COLOR "\nStatistics:\n" VT_RST);
+    fprintf(print_out, "    Commands:       %d (%" PRIu64 " Gfx, %" PRIu64 " bytes)\n", state->n_gfx,
+            state->n_gfx_words, state->n_gfx_words * sizeof(Gfx));
+    fprintf(print_out, "    DL stack:       %d of %d deep\n", state->max_dl_stack_top + 1,
+            (int)ARRAY_COUNT(state->dl_stack_ra));
+    fprintf(print_out, "    Matrix stack:   %d of %d deep (%u of %u bytes)\n", state->max_matrix_stack_depth,
+            (int)(state->sp_dram_stack_size / sizeof(Mtx)), (unsigned)(state->max_matrix_stack_depth * sizeof(Mtx)),
+            state->sp_dram_stack_size);
+    fprintf(print_out, "    Display lists:  %zu distinct ranges, %" PRIu64 " bytes\n", n_runs, dl_bytes);
+
+    if (pool_end <= pool_start)
+        return;
+
+    // Display lists executed inside the pool count as referenced too
+    for (size_t i = 0; i < n_runs; i++) {
+        AddrRange *run = obstack_at(&state->gfx_runs, i);
+
+        if (run->start < pool_end && run->end > pool_start)
+            obstack_push(&state->pool_refs, run);
+    }
+
+    size_t     n_refs     = addr_ranges_merge(state->pool_refs.start, state->pool_refs.count);
+    AddrRange *refs       = state->pool_refs.start;
+    uint64_t   pool_bytes = 0;
+
+    for (size_t i = 0; i < n_refs; i++)
+        pool_bytes += MIN(refs[i].end, pool_end) - MAX(refs[i].start, pool_start);
+
+    fprintf(print_out, "    Gfx pool:       %" PRIu64 " of %u bytes referenced (%.1f%%)\n", pool_bytes,
+            pool_end - pool_start, 100.0 * pool_bytes / (pool_end - pool_start));
+}
+
+/**
+ * Rewrites the root display list without the commands found to have no effect, writes it out in binary and as a C
+ * listing and prints what was saved.
+ */
+static void
+write_optimized_dl(FILE *print_out, gfx_state_t *state)
+{
+    size_t              n_cmds = state->opt_cmds.count;
+    ArenaMark           mark   = arena_mark(&state->arena);
+    uint32_t            vaddr  = state->root_dl | 0x80000000;
+    const gbd_symbol_t *sym    = NULL;
+    char                name[64];
+    OptStats            stats;
+
+    if (!state->task_done || state->opt_failed) {
+        fprintf(print_out, ERROR_COLOR "Display list not rewritten as it did not run to completion" VT_RST "\n");
+        return;
+    }
+
+    uint32_t *gfx = arena_alloc(&state->arena, n_cmds * sizeof(Gfx));
+    if (gfx == NULL) {
+        fprintf(print_out, ERROR_COLOR "FAILED to allocate rewritten display list" VT_RST "\n");
+        return;
+    }
+    size_t n_gfx = opt_rewrite(state->opt_cmds.start, n_cmds, gfx, &stats);
+
+    if (state->options->symbols != NULL)
+        sym = gbd_symbols_lookup(state->options->symbols, vaddr);
+    if (sym != NULL && sym->addr == vaddr)
+        snprintf(name, sizeof(name), "%s", sym->name);
+    else
+        snprintf(name, sizeof(name), "dl_%08X", vaddr);
+
+    fprintf(print_out, DIAG_COLOR "\nOptimized %s:\n" VT_RST, name);
+    fprintf(print_out, "    Gfx:       %d -> %d (%d bytes saved)\n", stats.n_in, stats.n_out,
+            (stats.n_in - stats.n_out) * (int)sizeof(Gfx));
+    fprintf(print_out, "    Dropped:   %d redundant state changes, superfluous syncs and unused vertex loads\n",
+            stats.n_dropped);
+    fprintf(print_out, "    Merged:    %d SP1Triangle pairs into SP2Triangles\n", stats.n_tris_merged);
+    fprintf(print_out, "    Trimmed:   %d vertices from vertex loads\n", stats.n_vtx_trimmed);
+    fprintf(print_out, "    Estimated: %" PRIu64 " RSP cycles (%.2fus), %" PRIu64 " RDP cycles (%.2fus) saved\n",
+            stats.rsp_saved, stats.rsp_saved / COST_CLOCK_MHZ, stats.rdp_saved, stats.rdp_saved / COST_CLOCK_MHZ);
+
+    if (opt_write_bin(gfx, n_gfx, state->options->optimize_path) != 0)
+        fprintf(print_out, ERROR_COLOR "FAILED to write %s" VT_RST "\n", state->options->optimize_path);
+    if (state->options->optimize_c_path != NULL &&
+        opt_write_c(gfx, n_gfx, state->next_ucode, name, state->options->optimize_c_path) != 0)
+        fprintf(print_out, ERROR_COLOR "FAILED to write %s" VT_RST "\n", state->options->optimize_c_path);
+
+    arena_release(&state->arena, mark);
+}
+
+/**************************************************************************
+ *  Main
+ */
+
+int
+analyze_gbi(FILE *print_out, gfx_ucode_registry_t *ucodes, gbd_options_t *opts, rdram_interface_t *rdram,
+            const void *rdram_arg, struct start_location_info *start_location, gbd_result_t *result)
+{
+    gfx_state_t state = {
+        .task_done        = false,
+        .pipeline_crashed = false,
+        .multi_packet     = false,
+        .n_warnings       = 0,
+        .n_errors         = 0,
+        .first_error_num  = -1,
+
+        .last_gfx_pkt_count = 1,
+
+        .segment_table[0]      = 0,
+        .segment_set_bits      = 1,
+        .matrix_stack_depth    = 0,
+        .matrix_projection_set = false,
+        .matrix_modelview_set  = false,
+
+        .ex3_mat_cull_mode = 0,
 
         .sp_dram_stack_size = 0x400, // TODO this is configurable
 
@@ -4717,6 +6814,8 @@ analyze_gbi(FILE *print_out, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
         .render_tile_on      = false,
         .last_loaded_vtx_num = 0,
         .persp_norm          = 1.0f,
+        .num_lights          = 1,
+        .clip_ratio          = 2,
         .geometry_mode       = G_CLIPPING,
         .dl_stack_top        = -1,
         .scissor_set         = false,
@@ -4727,13 +6826,17 @@ analyze_gbi(FILE *print_out, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
         .pipe_busy           = false,
         .tile_busy           = { 0 },
         .load_busy           = false,
+        .opt_first           = -1,
+        .opt_cur             = -1,
+        .max_dl_stack_top    = -1,
         .fill_color          = 0,
         .fill_color_set      = false,
     };
 
-    state.ucodes  = ucodes;
-    state.rdram   = rdram;
-    state.options = opts;
+    state.ucodes    = ucodes;
+    state.rdram     = rdram;
+    state.options   = opts;
+    state.print_out = print_out;
 
     if (state.options->string_encoding == NULL) {
         state.options->string_encoding = "EUC-JP";
@@ -4777,14 +6880,44 @@ analyze_gbi(FILE *print_out, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
         goto err;
     }
     state.gfx_addr = start_addr;
-
-    obstack_new(&state.disp_stack, sizeof(DispEntry));
-    obstack_new(&state.mtx_stack, sizeof(MtxF));
+    state.root_dl  = start_addr;
+
+    arena_new(&state.arena, ARENA_BLOCK_SIZE);
+    obstack_new(&state.disp_stack, &state.arena, sizeof(DispEntry));
+    obstack_new(&state.disp_site_list, &state.arena, sizeof(DispSite *));
+    hashmap_new(&state.disp_sites);
+    obstack_new(&state.folded_list, &state.arena, sizeof(FoldedStack *));
+    hashmap_new(&state.folded_stacks);
+    obstack_new(&state.dl_profile_list, &state.arena, sizeof(DlProfile *));
+    hashmap_new(&state.dl_profiles);
+    obstack_new(&state.raster_list, &state.arena, sizeof(Raster *));
+    hashmap_new(&state.rasters);
+    obstack_new(&state.mtx_stack, &state.arena, sizeof(MtxF));
+    texcache_new(&state.texcache, &state.arena);
+    hashmap_new(&state.strings);
+    state.str_cd = (iconv_t)-1;
+    tmem_reset(&state.tmem);
+    obstack_new(&state.tmem_reloads, &state.arena, sizeof(TmemReload));
+    obstack_new(&state.mat_run, &state.arena, sizeof(MaterialKey));
+    obstack_new(&state.opt_cmds, &state.arena, sizeof(OptCmd));
+    obstack_new(&state.gfx_runs, &state.arena, sizeof(AddrRange));
+    obstack_new(&state.pool_refs, &state.arena, sizeof(AddrRange));
+    if (state.options->optimize_path != NULL) {
+        // The state the display list will be called in is unknown, assume that every sync is needed on entry
+        state.pipe_busy    = true;
+        state.load_busy    = true;
+        state.tiles_in_use = true;
+        for (int v = 0; v < VTX_CACHE_SIZE; v++)
+            state.opt_vtx_cmd[v] = -1;
+    }
     MtxF zero_mf = { 0 };
     obstack_push(&state.mtx_stack, &zero_mf);
 
     gfxd_input_callback(input_callback);
-    gfxd_output_fd(fileno(print_out));
+    if (state.options->quiet)
+        gfxd_output_callback(empty_output_callback);
+    else
+        gfxd_output_fd(fileno(print_out));
 
     gfxd_udata_set(&state);
 
@@ -4811,11 +6944,44 @@ analyze_gbi(FILE *print_out, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
     gfxd_target(state.next_ucode);
 
     state.n_gfx = 0;
+
+    bool         folded      = state.options->folded_path != NULL;
+    bool         disp_prof   = disp_profiling(state.options);
+    bool         dl_prof     = state.options->cost_report || state.options->tri_report;
+    DispSite    *site        = &state.no_disp_site;
+    FoldedStack *stack       = folded ? folded_stack_cur(&state) : NULL;
+    WorkCounters work_before = work_snapshot(&state);
+    DlProfile   *dl_path[ARRAY_COUNT(state.dl_stack_pc) + 1];
+    int          dl_path_len = dl_prof ? dl_profile_path(&state, dl_path) : 0;
+
     while (!state.task_done && !state.pipeline_crashed && gfxd_execute() == 1) {
         state.n_gfx++;
         state.gfx_addr += state.last_gfx_pkt_count * sizeof(Gfx);
         gfxd_target(state.next_ucode);
 
+        if (disp_prof || folded || dl_prof) {
+            // Attribute the command to the DISP and call stack it started in
+            WorkCounters work_after = work_snapshot(&state);
+
+            if (disp_prof) {
+                work_add_delta(&site->work, &work_before, &work_after);
+                site = disp_site_cur(&state);
+            }
+            if (folded) {
+                if (stack != NULL)
+                    stack->weight += folded_weight(&state, &work_before, &work_after);
+                stack = folded_stack_cur(&state);
+            }
+            if (dl_prof) {
+                if (dl_path_len != 0)
+                    work_add_delta(&dl_path[dl_path_len - 1]->self, &work_before, &work_after);
+                for (int i = 0; i < dl_path_len; i++)
+                    work_add_delta(&dl_path[i]->total, &work_before, &work_after);
+                dl_path_len = dl_profile_path(&state, dl_path);
+            }
+            work_before = work_after;
+        }
+
         if (state.options->to_num != 0 && state.n_gfx == state.options->to_num) {
             state.task_done = true;
             break;
@@ -4860,7 +7026,7 @@ analyze_gbi(FILE *print_out, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
         }
 
         fprintf(print_out, DIAG_COLOR "\nDISP Refs Trace:\n" VT_RST);
-        VECTOR_FOR_EACH_ELEMENT_REVERSED(&state.disp_stack.v, ent, DispEntry *)
+        OBSTACK_FOR_EACH_ELEMENT_REVERSED(&state.disp_stack, ent, DispEntry *)
         {
             fprintf(print_out, "    At ");
             print_string(&state, ent->str_addr, fprintf, print_out);
@@ -4913,14 +7079,74 @@ analyze_gbi(FILE *print_out, gfx_ucode_registry_t *ucodes, gbd_options_t *opts,
         }
     }
 
+    if (state.options->report_dup_textures)
+        print_dup_textures(print_out, &state.texcache);
+
+    if (state.options->tmem_report)
+        print_tmem_report(print_out, &state.tmem.stats, &state.tmem_reloads);
+
+    if (state.options->profile_disp)
+        print_disp_profile(print_out, &state);
+
+    if (state.options->folded_path != NULL)
+        write_folded_stacks(print_out, &state);
+
+    if (state.options->cost_report) {
+        WorkCounters work = work_snapshot(&state);
+        print_cost_report(print_out, &state, &work);
+    }
+
+    if (state.options->overdraw_path != NULL)
+        print_overdraw(print_out, &state);
+
+    if (state.options->redundant_report)
+        print_redundant_report(print_out, &state);
+
+    if (state.options->tri_report)
+        print_tri_report(print_out, &state);
+
+    if (state.options->vtx_cache_report) {
+        // Vertices still in the cache at the end of the task were never going to be used
+        for (int v = 0; v < VTX_CACHE_SIZE; v++)
+            vtx_cache_evict(&state, v);
+        print_vtx_cache_report(print_out, &state);
+    }
+
+    if (state.options->material_report) {
+        material_run_end(&state);
+        print_material_report(print_out, &state);
+    }
+
+    if (state.options->optimize_path != NULL)
+        write_optimized_dl(print_out, &state);
+
+    if (state.options->task_stats)
+        print_task_stats(print_out, &state);
+
     fflush(print_out);
 
-    // TODO output more information here
-    // for verbose outputs, the maximum depth reached on the DL stack might be useful, also
-    //  the percentage of the gfxpool that gets used by this graphics task?
-    // also output any warnings and what the cause of the crash is if applicable
+    // TODO also output any warnings and what the cause of the crash is if applicable
 
+    texcache_destroy(&state.texcache);
+    hashmap_destroy(&state.disp_sites);
+    hashmap_destroy(&state.folded_stacks);
+    hashmap_destroy(&state.dl_profiles);
+    OBSTACK_FOR_EACH_ELEMENT(&state.raster_list, rp, Raster **)
+    {
+        raster_free(*rp);
+    }
+    hashmap_destroy(&state.rasters);
+    free_strings(&state);
+    arena_destroy(&state.arena);
     state.rdram->close();
+
+    if (result != NULL) {
+        result->task_done       = state.task_done;
+        result->n_gfx           = state.n_gfx;
+        result->n_warnings      = state.n_warnings;
+        result->n_errors        = state.n_errors;
+        result->first_error_num = state.first_error_num;
+    }
     return 0;
 err:
     state.rdram->close();
@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashmap.h"
+
+#define HASHMAP_MIN_CAPACITY 64
+
+static inline size_t
+hashmap_slot(const HashMap *map, uint64_t key)
+{
+    // Fold the high bits in so that keys that are mostly addresses still spread across the table
+    return (size_t)(key ^ (key >> 29) ^ (key >> 47)) & (map->capacity - 1);
+}
+
+void
+hashmap_new(HashMap *map)
+{
+    map->count    = 0;
+    map->capacity = 0;
+    map->entries  = NULL;
+}
+
+int
+hashmap_destroy(HashMap *map)
+{
+    if (map->entries != NULL)
+        free(map->entries);
+    hashmap_new(map);
+    return 0;
+}
+
+void *
+hashmap_get(const HashMap *map, uint64_t key)
+{
+    if (map->entries == NULL)
+        return NULL;
+
+    for (size_t i = hashmap_slot(map, key);; i = (i + 1) & (map->capacity - 1)) {
+        HashMapEntry *entry = &map->entries[i];
+
+        if (entry->value == NULL)
+            return NULL;
+        if (entry->key == key)
+            return entry->value;
+    }
+}
+
+static int
+hashmap_grow(HashMap *map)
+{
+    size_t        old_capacity = map->capacity;
+    HashMapEntry *old_entries  = map->entries;
+    size_t        new_capacity = (old_capacity == 0) ? HASHMAP_MIN_CAPACITY : old_capacity * 2;
+    HashMapEntry *new_entries  = calloc(new_capacity, sizeof(HashMapEntry));
+
+    if (new_entries == NULL)
+        return -1;
+
+    map->capacity = new_capacity;
+    map->entries  = new_entries;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_entries[i].value == NULL)
+            continue;
+
+        size_t j = hashmap_slot(map, old_entries[i].key);
+        while (new_entries[j].value != NULL)
+            j = (j + 1) & (new_capacity - 1);
+        new_entries[j] = old_entries[i];
+    }
+
+    free(old_entries);
+    return 0;
+}
+
+/**
+ * Inserts or replaces the value for `key`. Returns 0 on success, -1 if the table could not be grown.
+ */
+int
+hashmap_put(HashMap *map, uint64_t key, void *value)
+{
+    // Keep the load factor under 3/4
+    if ((map->count + 1) * 4 > map->capacity * 3 && hashmap_grow(map) != 0)
+        return -1;
+
+    for (size_t i = hashmap_slot(map, key);; i = (i + 1) & (map->capacity - 1)) {
+        HashMapEntry *entry = &map->entries[i];
+
+        if (entry->value == NULL) {
+            entry->key   = key;
+            entry->value = value;
+            map->count++;
+            return 0;
+        }
+        if (entry->key == key) {
+            entry->value = value;
+            return 0;
+        }
+    }
+}
+
+void
+hashmap_clear(HashMap *map)
+{
+    if (map->entries != NULL)
+        memset(map->entries, 0, map->capacity * sizeof(HashMapEntry));
+    map->count = 0;
+}
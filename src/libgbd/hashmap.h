@@ -0,0 +1,43 @@
+#ifndef HASHMAP_H_
+#define HASHMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  Open-addressed map from 64-bit keys to non-NULL pointers. Keys are expected to already be well-distributed
+ *  (e.g. the output of a hash function or a packed address), no further mixing is done.
+ */
+
+typedef struct {
+    uint64_t key;
+    void    *value;
+} HashMapEntry;
+
+typedef struct HashMap {
+    size_t        count;
+    size_t        capacity;
+    HashMapEntry *entries;
+} HashMap;
+
+#define HASHMAP_FOR_EACH_ENTRY(map, entry)                                                          \
+    for ((entry) = (map)->entries; (entry) != NULL && (entry) != (map)->entries + (map)->capacity; \
+         (entry)++)                                                                                 \
+        if ((entry)->value != NULL)
+
+void
+hashmap_new(HashMap *map);
+
+int
+hashmap_destroy(HashMap *map);
+
+void *
+hashmap_get(const HashMap *map, uint64_t key);
+
+int
+hashmap_put(HashMap *map, uint64_t key, void *value);
+
+void
+hashmap_clear(HashMap *map);
+
+#endif
@@ -1,41 +1,84 @@
 #ifndef OBSTACK_H_
 #define OBSTACK_H_
 
-#include "vector.h"
+#include <string.h>
+
+#include "arena.h"
 #include "macros.h"
 
+/**
+ *  Stack of fixed-size objects stored contiguously in an arena. Growing copies the contents into a new, larger
+ *  allocation, the old one is reclaimed when the arena is released.
+ */
 typedef struct {
-    Vector v;
+    Arena *arena;
+    size_t elem_size;
+    size_t count;
+    size_t capacity;
+    void  *start;
 } ObStack;
 
+#define OBSTACK_MIN_CAPACITY 16
+
+#define OBSTACK_FOR_EACH_ELEMENT(obstack, element, type) \
+    for (type(element) = (type)(obstack)->start; (element) != (type)(obstack)->start + (obstack)->count; (element)++)
+
+#define OBSTACK_FOR_EACH_ELEMENT_REVERSED(obstack, element, type)                                            \
+    for (type(element) = (type)(obstack)->start + (obstack)->count; (element) != (type)(obstack)->start && \
+                                                                     ((element)--, 1);)
+
 static ALWAYS_INLINE void
-obstack_new(ObStack *obstack, size_t elem_size)
+obstack_new(ObStack *obstack, Arena *arena, size_t elem_size)
 {
-    vector_new(&obstack->v, elem_size);
+    obstack->arena     = arena;
+    obstack->elem_size = elem_size;
+    obstack->count     = 0;
+    obstack->capacity  = 0;
+    obstack->start     = NULL;
 }
 
-static ALWAYS_INLINE int
-obstack_free(ObStack *obstack)
+static ALWAYS_INLINE void *
+obstack_at(ObStack *obstack, size_t pos)
 {
-    return vector_destroy(&obstack->v);
+    if (pos >= obstack->count)
+        return NULL;
+    return (uint8_t *)obstack->start + obstack->elem_size * pos;
 }
 
-static ALWAYS_INLINE void *
+static inline void *
 obstack_push(ObStack *obstack, const void *ob)
 {
-    return vector_push_back(&obstack->v, 1, ob);
+    if (obstack->count == obstack->capacity) {
+        size_t new_capacity = (obstack->capacity == 0) ? OBSTACK_MIN_CAPACITY : obstack->capacity * 2;
+        void  *new_start    = arena_alloc(obstack->arena, new_capacity * obstack->elem_size);
+
+        if (new_start == NULL)
+            return NULL;
+        if (obstack->count != 0)
+            memcpy(new_start, obstack->start, obstack->count * obstack->elem_size);
+
+        obstack->start    = new_start;
+        obstack->capacity = new_capacity;
+    }
+
+    void *top = (uint8_t *)obstack->start + obstack->elem_size * obstack->count++;
+    memcpy(top, ob, obstack->elem_size);
+    return top;
 }
 
 static ALWAYS_INLINE int
 obstack_pop(ObStack *obstack, int n)
 {
-    return vector_delete(&obstack->v, obstack->v.limit - 1, 1);
+    if ((size_t)n > obstack->count)
+        return -1;
+    obstack->count -= n;
+    return 0;
 }
 
 static ALWAYS_INLINE void *
 obstack_peek(ObStack *obstack)
 {
-    return vector_at(&obstack->v, obstack->v.limit - 1);
+    return (obstack->count != 0) ? obstack_at(obstack, obstack->count - 1) : NULL;
 }
 
 #endif
@@ -0,0 +1,176 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "optimize.h"
+#include "gfx.h"
+#include "cost.h"
+#include "macros.h"
+
+#define F3DEX2_TRI_VERTS 0x00FFFFFF // vertex indices of an SP1Triangle, in the low bits of its first word
+
+/**
+ * Writes the rewritten display list for `n_cmds` recorded commands to `out`, which must have room for two words per
+ * command, and returns the number of Gfx written. Dropped commands are left out, SPVertex loads are trimmed to the
+ * slots that were used, and each SP1Triangle immediately followed by another in the output is merged with it into an
+ * SP2Triangles. Vertex slots are never renumbered so trimming a load does not affect the triangles using it.
+ */
+size_t
+opt_rewrite(const OptCmd *cmds, size_t n_cmds, uint32_t *out, OptStats *stats)
+{
+    size_t n_out   = 0;
+    long   tri_pos = -1; // output position of an SP1Triangle the next triangle can be merged into
+
+    *stats = (OptStats){
+        .n_in = n_cmds,
+    };
+
+    for (size_t i = 0; i < n_cmds; i++) {
+        const OptCmd *cmd = &cmds[i];
+        uint32_t      w0  = cmd->words[0];
+        uint32_t      w1  = cmd->words[1];
+
+        if (cmd->drop) {
+            stats->n_dropped++;
+            stats->rsp_saved += COST_RSP_CMD;
+            stats->rdp_saved += cmd->rdp_cost;
+            continue;
+        }
+
+        if (cmd->kind == OPT_CMD_VTX) {
+            if (cmd->used_hi < cmd->used_lo) {
+                // Nothing used any of the vertices
+                stats->n_dropped++;
+                stats->n_vtx_trimmed += cmd->n;
+                stats->rsp_saved += COST_RSP_CMD + (uint64_t)cmd->n * cmd->vtx_cost;
+                continue;
+            }
+
+            int n = cmd->used_hi - cmd->used_lo + 1;
+
+            if (n != cmd->n) {
+                w0 = ((uint32_t)G_VTX << 24) | ((uint32_t)n << 12) | (((cmd->used_lo + n) & 0x7F) << 1);
+                w1 += (cmd->used_lo - cmd->v0) * sizeof(Vtx);
+                stats->n_vtx_trimmed += cmd->n - n;
+                stats->rsp_saved += (uint64_t)(cmd->n - n) * cmd->vtx_cost;
+            }
+        }
+
+        if (cmd->kind == OPT_CMD_TRI1) {
+            if (tri_pos >= 0) {
+                out[2 * tri_pos + 0] = ((uint32_t)G_TRI2 << 24) | (out[2 * tri_pos + 0] & F3DEX2_TRI_VERTS);
+                out[2 * tri_pos + 1] = w0 & F3DEX2_TRI_VERTS;
+                tri_pos              = -1;
+                stats->n_tris_merged++;
+                stats->rsp_saved += COST_RSP_CMD;
+                continue;
+            }
+            tri_pos = n_out;
+        } else {
+            tri_pos = -1;
+        }
+
+        out[2 * n_out + 0] = w0;
+        out[2 * n_out + 1] = w1;
+        n_out++;
+    }
+
+    stats->n_out = n_out;
+    return n_out;
+}
+
+/**
+ * Converts `n_gfx` Gfx to big-endian bytes as they are laid out in RDRAM. Returns NULL if out of memory.
+ */
+static uint8_t *
+opt_to_bytes(const uint32_t *gfx, size_t n_gfx)
+{
+    uint8_t *bytes = malloc(n_gfx * sizeof(Gfx));
+
+    if (bytes == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < 2 * n_gfx; i++) {
+        bytes[4 * i + 0] = gfx[i] >> 24;
+        bytes[4 * i + 1] = gfx[i] >> 16;
+        bytes[4 * i + 2] = gfx[i] >> 8;
+        bytes[4 * i + 3] = gfx[i] >> 0;
+    }
+    return bytes;
+}
+
+/**
+ * Writes `n_gfx` Gfx to `path` as they are laid out in RDRAM. Returns 0 on success.
+ */
+int
+opt_write_bin(const uint32_t *gfx, size_t n_gfx, const char *path)
+{
+    uint8_t *bytes = opt_to_bytes(gfx, n_gfx);
+    FILE    *out;
+    int      ret = -1;
+
+    if (bytes == NULL)
+        return -1;
+
+    out = fopen(path, "wb");
+    if (out != NULL) {
+        ret = (fwrite(bytes, sizeof(Gfx), n_gfx, out) == n_gfx) ? 0 : -1;
+        if (fclose(out) != 0)
+            ret = -1;
+    }
+    free(bytes);
+    return ret;
+}
+
+static int
+opt_listing_output(const char *buf, int count)
+{
+    return fwrite(buf, 1, count, gfxd_udata_get());
+}
+
+static int
+opt_listing_macro(void)
+{
+    gfxd_puts("    ");
+    gfxd_macro_dflt();
+    gfxd_puts(",\n");
+    return 0;
+}
+
+/**
+ * Writes `n_gfx` Gfx to `path` as a C array named `name`, disassembled for `ucode`. Returns 0 on success.
+ */
+int
+opt_write_c(const uint32_t *gfx, size_t n_gfx, gfxd_ucode_t ucode, const char *name, const char *path)
+{
+    uint8_t *bytes = opt_to_bytes(gfx, n_gfx);
+    FILE    *out;
+    int      ret = -1;
+
+    if (bytes == NULL)
+        return -1;
+
+    out = fopen(path, "w");
+    if (out != NULL) {
+        fprintf(out, "Gfx %s[] = {\n", name);
+
+        gfxd_input_buffer(bytes, n_gfx * sizeof(Gfx));
+        gfxd_output_callback(opt_listing_output);
+        gfxd_udata_set(out);
+        gfxd_endian(gfxd_endian_big, 4);
+        gfxd_macro_fn(opt_listing_macro);
+        gfxd_arg_fn(NULL);
+        gfxd_disable(gfxd_emit_ext_macro);
+        gfxd_disable(gfxd_stop_on_end);
+        gfxd_target(ucode);
+        gfxd_execute();
+
+        fprintf(out, "};\n");
+        ret = ferror(out) ? -1 : 0;
+        if (fclose(out) != 0)
+            ret = -1;
+    }
+    free(bytes);
+    return ret;
+}
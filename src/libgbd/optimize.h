@@ -0,0 +1,54 @@
+#ifndef OPTIMIZE_H_
+#define OPTIMIZE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libgfxd/gfxd.h"
+
+/**
+ *  Rewriting of a static display list. The commands of the display list are recorded while it is analyzed, along with
+ *  what the analysis found out about each of them, and are then written out again without the commands that were found
+ *  to have no effect. Triangles are merged and vertex loads shrunk only for F3DEX2, whose encodings are known here.
+ */
+
+enum opt_cmd_kind {
+    OPT_CMD_OTHER,
+    OPT_CMD_TRI1, // F3DEX2 SP1Triangle
+    OPT_CMD_VTX,  // F3DEX2 SPVertex
+};
+
+typedef struct {
+    uint32_t          words[2];
+    enum opt_cmd_kind kind;
+    bool              drop;     // redundant state change or superfluous sync
+    uint32_t          rdp_cost; // RDP cycles the command costs beyond being fetched
+    // SPVertex
+    int      v0;
+    int      n;
+    int      used_lo;  // lowest vertex slot loaded by this command that was used before being replaced
+    int      used_hi;  // highest such slot, less than used_lo if none was used
+    uint32_t vtx_cost; // RSP cycles spent on each vertex
+} OptCmd;
+
+typedef struct {
+    int      n_in;          // commands before rewriting, in Gfx words
+    int      n_out;         // commands after rewriting, in Gfx words
+    int      n_dropped;     // commands removed
+    int      n_tris_merged; // SP2Triangles made from pairs of SP1Triangle
+    int      n_vtx_trimmed; // vertices no longer loaded
+    uint64_t rsp_saved;     // estimated, see cost.h
+    uint64_t rdp_saved;     // estimated, see cost.h
+} OptStats;
+
+size_t
+opt_rewrite(const OptCmd *cmds, size_t n_cmds, uint32_t *out, OptStats *stats);
+
+int
+opt_write_bin(const uint32_t *gfx, size_t n_gfx, const char *path);
+
+int
+opt_write_c(const uint32_t *gfx, size_t n_gfx, gfxd_ucode_t ucode, const char *name, const char *path);
+
+#endif
@@ -0,0 +1,310 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+#include "raster.h"
+#include "macros.h"
+
+/**
+ *  Triangles are rasterized with edge functions sampled at pixel centers. The bounding box is walked in tiles, each
+ *  tile is first classified from its corners: tiles outside of an edge are skipped and tiles inside every edge are
+ *  filled without testing each pixel, leaving only tiles crossed by an edge to be tested per pixel, 8 pixels at a time
+ *  where SSE2 is available.
+ */
+
+typedef struct {
+    float  a;   // change per pixel in x
+    float  b;   // change per pixel in y
+    double c;   // value at the origin
+    bool   tie; // whether samples lying exactly on the edge are inside
+} Edge;
+
+int
+raster_new(Raster *r, uint32_t cimg, int width, int height)
+{
+    r->cimg     = cimg;
+    r->width    = width;
+    r->stride   = (width + RASTER_TILE - 1) & ~(RASTER_TILE - 1);
+    r->height   = height;
+    r->max_y    = 0;
+    r->pixels   = 0;
+    r->coverage = calloc((size_t)r->stride * height, sizeof(uint16_t));
+    return (r->coverage != NULL) ? 0 : -1;
+}
+
+void
+raster_free(Raster *r)
+{
+    free(r->coverage);
+    r->coverage = NULL;
+}
+
+static void
+edge_setup(Edge *e, const float p[2], const float q[2])
+{
+    e->a = p[1] - q[1];
+    e->b = q[0] - p[0];
+    e->c = -((double)e->a * p[0] + (double)e->b * p[1]);
+    // Two triangles sharing this edge see it in opposite directions, so exactly one of them owns samples lying on it
+    e->tie = e->a > 0.0f || (e->a == 0.0f && e->b > 0.0f);
+}
+
+static inline double
+edge_at(const Edge *e, double x, double y)
+{
+    return e->a * x + e->b * y + e->c;
+}
+
+static inline bool
+edge_inside(const Edge *e, double v)
+{
+    return e->tie ? v >= 0.0 : v > 0.0;
+}
+
+/**
+ * Draws `n` pixels of row `y` starting at `x`.
+ */
+static void
+raster_fill_span(Raster *r, int x, int y, int n)
+{
+    uint16_t *cov = &r->coverage[(size_t)y * r->stride + x];
+
+    for (int i = 0; i < n; i++) {
+        if (cov[i] != UINT16_MAX)
+            cov[i]++;
+    }
+}
+
+/**
+ * Draws the pixels among the 8 starting at `x` on row `y` whose centers are inside all three edges and which lie in
+ * [`x_min`, `x_max`), returns the number drawn. `x` must be a multiple of 8.
+ */
+static int
+raster_span8(Raster *r, const Edge e[3], int x, int y, int x_min, int x_max)
+{
+    uint16_t *cov = &r->coverage[(size_t)y * r->stride + x];
+#if defined(__SSE2__)
+    __m128 zero      = _mm_setzero_ps();
+    __m128 inside_lo = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    __m128 inside_hi = inside_lo;
+
+    for (int i = 0; i < 3; i++) {
+        __m128 base = _mm_set1_ps((float)edge_at(&e[i], x + 0.5, y + 0.5));
+        __m128 step = _mm_set1_ps(e[i].a);
+        __m128 v_lo = _mm_add_ps(base, _mm_mul_ps(step, _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)));
+        __m128 v_hi = _mm_add_ps(base, _mm_mul_ps(step, _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f)));
+
+        if (e[i].tie) {
+            inside_lo = _mm_and_ps(inside_lo, _mm_cmpge_ps(v_lo, zero));
+            inside_hi = _mm_and_ps(inside_hi, _mm_cmpge_ps(v_hi, zero));
+        } else {
+            inside_lo = _mm_and_ps(inside_lo, _mm_cmpgt_ps(v_lo, zero));
+            inside_hi = _mm_and_ps(inside_hi, _mm_cmpgt_ps(v_hi, zero));
+        }
+    }
+
+    // Narrow to one 16-bit lane per pixel to match the coverage counts, then drop pixels outside of the bounds
+    __m128i inside = _mm_packs_epi32(_mm_castps_si128(inside_lo), _mm_castps_si128(inside_hi));
+    __m128i lanes  = _mm_add_epi16(_mm_set1_epi16(x), _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+    inside         = _mm_and_si128(inside, _mm_cmpgt_epi16(lanes, _mm_set1_epi16(x_min - 1)));
+    inside         = _mm_and_si128(inside, _mm_cmplt_epi16(lanes, _mm_set1_epi16(x_max)));
+
+    int bits = _mm_movemask_epi8(inside);
+    if (bits == 0)
+        return 0;
+
+    __m128i counts = _mm_loadu_si128((const __m128i *)cov);
+    counts         = _mm_adds_epu16(counts, _mm_and_si128(inside, _mm_set1_epi16(1)));
+    _mm_storeu_si128((__m128i *)cov, counts);
+    return __builtin_popcount(bits) / 2;
+#else
+    int n = 0;
+
+    for (int i = 0; i < 8; i++) {
+        int px = x + i;
+
+        if (px < x_min || px >= x_max)
+            continue;
+
+        if (edge_inside(&e[0], edge_at(&e[0], px + 0.5, y + 0.5)) &&
+            edge_inside(&e[1], edge_at(&e[1], px + 0.5, y + 0.5)) &&
+            edge_inside(&e[2], edge_at(&e[2], px + 0.5, y + 0.5))) {
+            if (cov[i] != UINT16_MAX)
+                cov[i]++;
+            n++;
+        }
+    }
+    return n;
+#endif
+}
+
+/**
+ * Intersects `clip` with the bounds of the raster.
+ */
+static RasterRect
+raster_clip(const Raster *r, const RasterRect *clip)
+{
+    RasterRect bounds = {
+        .x0 = MAX(clip->x0, 0),
+        .y0 = MAX(clip->y0, 0),
+        .x1 = MIN(clip->x1, r->width),
+        .y1 = MIN(clip->y1, r->height),
+    };
+    return bounds;
+}
+
+/**
+ * Draws a triangle given by screen positions in pixels, limited to `clip`. Returns the number of pixels drawn.
+ */
+uint64_t
+raster_tri(Raster *r, const float v0[2], const float v1[2], const float v2[2], const RasterRect *clip)
+{
+    float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v2[0] - v0[0]) * (v1[1] - v0[1]);
+
+    if (!(area != 0.0f) || !isfinite(area))
+        return 0;
+
+    // Wind the edges so that the inside of the triangle is positive
+    if (area < 0.0f) {
+        const float *tmp = v1;
+        v1               = v2;
+        v2               = tmp;
+    }
+
+    Edge e[3];
+    edge_setup(&e[0], v0, v1);
+    edge_setup(&e[1], v1, v2);
+    edge_setup(&e[2], v2, v0);
+
+    // Bounding box, clamped before converting so that far away vertices do not overflow
+    RasterRect bounds = raster_clip(r, clip);
+    float      min_x  = MAX(MIN(MIN(v0[0], v1[0]), v2[0]), bounds.x0);
+    float      min_y  = MAX(MIN(MIN(v0[1], v1[1]), v2[1]), bounds.y0);
+    float      max_x  = MIN(MAX(MAX(v0[0], v1[0]), v2[0]), bounds.x1);
+    float      max_y  = MIN(MAX(MAX(v0[1], v1[1]), v2[1]), bounds.y1);
+    int        x_min  = (int)floorf(min_x);
+    int        y_min  = (int)floorf(min_y);
+    int        x_max  = (int)ceilf(max_x);
+    int        y_max  = (int)ceilf(max_y);
+
+    if (x_min >= x_max || y_min >= y_max)
+        return 0;
+
+    uint64_t n = 0;
+
+    for (int ty = y_min & ~(RASTER_TILE - 1); ty < y_max; ty += RASTER_TILE) {
+        for (int tx = x_min & ~(RASTER_TILE - 1); tx < x_max; tx += RASTER_TILE) {
+            // Edge functions are linear, so their extremes over the tile's samples are at its corner samples
+            bool full = tx >= x_min && tx + RASTER_TILE <= x_max && ty >= y_min && ty + RASTER_TILE <= y_max;
+            bool skip = false;
+
+            for (int i = 0; i < 3 && !skip; i++) {
+                double c00 = edge_at(&e[i], tx + 0.5, ty + 0.5);
+                double c10 = c00 + e[i].a * (RASTER_TILE - 1);
+                double c01 = c00 + e[i].b * (RASTER_TILE - 1);
+                double c11 = c10 + e[i].b * (RASTER_TILE - 1);
+                double lo  = MIN(MIN(c00, c10), MIN(c01, c11));
+                double hi  = MAX(MAX(c00, c10), MAX(c01, c11));
+
+                if (hi < 0.0)
+                    skip = true;
+                if (lo <= 0.0)
+                    full = false;
+            }
+            if (skip)
+                continue;
+
+            if (full) {
+                for (int y = ty; y < ty + RASTER_TILE; y++)
+                    raster_fill_span(r, tx, y, RASTER_TILE);
+                n += RASTER_TILE * RASTER_TILE;
+            } else {
+                for (int y = MAX(ty, y_min); y < MIN(ty + RASTER_TILE, y_max); y++)
+                    n += raster_span8(r, e, tx, y, x_min, x_max);
+            }
+        }
+    }
+
+    if (n != 0)
+        r->max_y = MAX(r->max_y, y_max);
+    r->pixels += n;
+    return n;
+}
+
+/**
+ * Draws a rectangle of whole pixels, limited to `clip`. Returns the number of pixels drawn.
+ */
+uint64_t
+raster_rect(Raster *r, const RasterRect *rect, const RasterRect *clip)
+{
+    RasterRect bounds = raster_clip(r, clip);
+    int        x0     = MAX(rect->x0, bounds.x0);
+    int        y0     = MAX(rect->y0, bounds.y0);
+    int        x1     = MIN(rect->x1, bounds.x1);
+    int        y1     = MIN(rect->y1, bounds.y1);
+
+    if (x0 >= x1 || y0 >= y1)
+        return 0;
+
+    for (int y = y0; y < y1; y++)
+        raster_fill_span(r, x0, y, x1 - x0);
+
+    uint64_t n = (uint64_t)(x1 - x0) * (y1 - y0);
+
+    r->max_y = MAX(r->max_y, y1);
+    r->pixels += n;
+    return n;
+}
+
+/**
+ * Returns the number of pixels drawn to at least once.
+ */
+uint64_t
+raster_covered(const Raster *r)
+{
+    uint64_t n = 0;
+
+    for (int y = 0; y < r->max_y; y++) {
+        for (int x = 0; x < r->width; x++)
+            n += r->coverage[(size_t)y * r->stride + x] != 0;
+    }
+    return n;
+}
+
+// Heatmap colors by number of times drawn, the last is used for anything higher
+static const uint8_t heatmap[][3] = {
+    { 0, 0, 0 },       { 0, 0, 160 },   { 0, 96, 255 },  { 0, 200, 200 },   { 0, 200, 0 },
+    { 230, 230, 0 },   { 255, 140, 0 }, { 255, 0, 0 },   { 255, 255, 255 },
+};
+
+/**
+ * Writes the coverage counts as a binary PPM image, down to the lowest row drawn to. Returns 0 on success.
+ */
+int
+raster_write_ppm(const Raster *r, const char *path)
+{
+    FILE *out = fopen(path, "wb");
+
+    if (out == NULL)
+        return -1;
+
+    fprintf(out, "P6\n%d %d\n255\n", r->width, MAX(r->max_y, 1));
+
+    for (int y = 0; y < MAX(r->max_y, 1); y++) {
+        for (int x = 0; x < r->width; x++) {
+            unsigned count = r->coverage[(size_t)y * r->stride + x];
+
+            fwrite(heatmap[MIN(count, ARRAY_COUNT(heatmap) - 1)], 3, 1, out);
+        }
+    }
+
+    if (fclose(out) != 0)
+        return -1;
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef RASTER_H_
+#define RASTER_H_
+
+#include <stdint.h>
+
+#define RASTER_TILE       8    // primitives are rasterized in square tiles of this many pixels
+#define RASTER_MAX_HEIGHT 1024 // rows kept for each color image, the height of a color image is not known
+
+/**
+ *  Coverage counting rasterizer, records how many times each pixel of a color image is drawn to so that overdraw can
+ *  be visualized. Only coverage is modelled, not color, depth or blending.
+ */
+typedef struct {
+    uint32_t  cimg;     // physical address of the color image
+    int       width;    // width of the color image in pixels
+    int       stride;   // width rounded up to a whole number of tiles
+    int       height;   // number of rows kept
+    int       max_y;    // one past the lowest row drawn to
+    uint64_t  pixels;   // total pixels drawn, counting each time a pixel is drawn
+    uint16_t *coverage; // number of times each pixel was drawn, saturating
+} Raster;
+
+// Half-open pixel rectangle
+typedef struct {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} RasterRect;
+
+int
+raster_new(Raster *r, uint32_t cimg, int width, int height);
+
+void
+raster_free(Raster *r);
+
+uint64_t
+raster_tri(Raster *r, const float v0[2], const float v1[2], const float v2[2], const RasterRect *clip);
+
+uint64_t
+raster_rect(Raster *r, const RasterRect *rect, const RasterRect *clip);
+
+uint64_t
+raster_covered(const Raster *r);
+
+int
+raster_write_ppm(const Raster *r, const char *path);
+
+#endif
@@ -0,0 +1,117 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libgbd/symbols.h"
+
+/**
+ *  Symbol Maps
+ *
+ *  Reads symbol maps with one symbol per line, the first field being the (hex) address and the last the name. This
+ *  covers `nm` output (`80123456 T gSomeDL`) as well as simple `0x80123456 gSomeDL` lists. Lines that do not start
+ *  with an address are skipped, so comments and headers are ignored.
+ */
+
+static int
+symbol_cmp(const void *a, const void *b)
+{
+    const gbd_symbol_t *sym_a = a;
+    const gbd_symbol_t *sym_b = b;
+
+    return (sym_a->addr > sym_b->addr) - (sym_a->addr < sym_b->addr);
+}
+
+/**
+ * Loads the symbol map at `path`, returns 0 on success.
+ */
+int
+gbd_symbols_load(gbd_symbols_t *symbols, const char *path)
+{
+    FILE  *f = fopen(path, "r");
+    char   line[512];
+    size_t capacity = 0;
+
+    symbols->syms  = NULL;
+    symbols->count = 0;
+
+    if (f == NULL)
+        return -1;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char         *end;
+        unsigned long addr = strtoul(line, &end, 16);
+
+        if (end == line || !isspace((unsigned char)*end))
+            continue;
+
+        // The name is the last field on the line
+        size_t len = strlen(end);
+        while (len != 0 && isspace((unsigned char)end[len - 1]))
+            end[--len] = '\0';
+        char *name = strrchr(end, ' ');
+        char *tab  = strrchr(end, '\t');
+        if (tab > name)
+            name = tab;
+        if (name == NULL || name[1] == '\0')
+            continue;
+        name++;
+
+        if (symbols->count == capacity) {
+            capacity = (capacity == 0) ? 256 : capacity * 2;
+
+            gbd_symbol_t *syms = realloc(symbols->syms, capacity * sizeof(gbd_symbol_t));
+            if (syms == NULL)
+                goto fail;
+            symbols->syms = syms;
+        }
+
+        char *name_copy = strdup(name);
+        if (name_copy == NULL)
+            goto fail;
+        symbols->syms[symbols->count++] = (gbd_symbol_t){
+            .addr = addr,
+            .name = name_copy,
+        };
+    }
+    fclose(f);
+
+    qsort(symbols->syms, symbols->count, sizeof(gbd_symbol_t), symbol_cmp);
+    return 0;
+fail:
+    fclose(f);
+    gbd_symbols_free(symbols);
+    return -1;
+}
+
+void
+gbd_symbols_free(gbd_symbols_t *symbols)
+{
+    for (size_t i = 0; i < symbols->count; i++)
+        free(symbols->syms[i].name);
+    free(symbols->syms);
+    symbols->syms  = NULL;
+    symbols->count = 0;
+}
+
+/**
+ * Returns the symbol at or closest before `addr`, or NULL if there is none.
+ */
+const gbd_symbol_t *
+gbd_symbols_lookup(const gbd_symbols_t *symbols, uint32_t addr)
+{
+    size_t lo = 0;
+    size_t hi = symbols->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (symbols->syms[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo == 0) ? NULL : &symbols->syms[lo - 1];
+}
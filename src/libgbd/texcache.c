@@ -0,0 +1,238 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gfx.h"
+#include "texcache.h"
+#include "xxhash.h"
+#include "macros.h"
+
+#define TEXCACHE_MAX_TEX_SIZE 0x100000 // nothing loadable into TMEM comes anywhere close to this
+
+// Expand an n-bit color component to 8 bits
+#define CVT_CH(c, sft, mask) ((((c) >> (sft)) & (mask)) * (255 / (mask)))
+
+#define RGBA8888(r, g, b, a) \
+    (((uint32_t)(r) << 24) | ((uint32_t)(g) << 16) | ((uint32_t)(b) << 8) | ((uint32_t)(a) << 0))
+
+void
+texcache_new(TexCache *cache, Arena *arena)
+{
+    cache->arena = arena;
+    hashmap_new(&cache->map);
+    obstack_new(&cache->entries, arena, sizeof(TexEntry *));
+    cache->scratch      = NULL;
+    cache->scratch_size = 0;
+    cache->n_hits       = 0;
+    cache->n_misses     = 0;
+}
+
+/**
+ * Frees everything not owned by the arena, entries and decoded texels are released along with the arena.
+ */
+void
+texcache_destroy(TexCache *cache)
+{
+    hashmap_destroy(&cache->map);
+    free(cache->scratch);
+    texcache_new(cache, cache->arena);
+}
+
+uint32_t
+tex_size_bytes(int siz, int width, int height)
+{
+    return ((uint32_t)width * (uint32_t)height * G_SIZ_BITS(siz) + 7) / 8;
+}
+
+static uint8_t *
+texcache_scratch(TexCache *cache, size_t size)
+{
+    if (size > cache->scratch_size) {
+        uint8_t *new_scratch = realloc(cache->scratch, size);
+
+        if (new_scratch == NULL)
+            return NULL;
+        cache->scratch      = new_scratch;
+        cache->scratch_size = size;
+    }
+    return cache->scratch;
+}
+
+static uint32_t
+texel_bits(const uint8_t *data, uint32_t idx, int siz)
+{
+    switch (siz) {
+        case G_IM_SIZ_4b:
+            return (idx & 1) ? (data[idx / 2] & 0xF) : (data[idx / 2] >> 4);
+        case G_IM_SIZ_8b:
+            return data[idx];
+        case G_IM_SIZ_16b:
+            return (data[idx * 2] << 8) | data[idx * 2 + 1];
+        default:
+            return ((uint32_t)data[idx * 4] << 24) | (data[idx * 4 + 1] << 16) | (data[idx * 4 + 2] << 8) |
+                   data[idx * 4 + 3];
+    }
+}
+
+static uint32_t
+tlut_to_rgba(uint16_t tlut_px, int tlut_type)
+{
+    if (tlut_type == G_TT_IA16) {
+        uint8_t i = CVT_CH(tlut_px, 8, 255);
+        return RGBA8888(i, i, i, CVT_CH(tlut_px, 0, 255));
+    }
+    return RGBA8888(CVT_CH(tlut_px, 11, 31), CVT_CH(tlut_px, 6, 31), CVT_CH(tlut_px, 1, 31), 255 * (tlut_px & 1));
+}
+
+static enum tex_status
+texcache_decode_data(TexCache *cache, TexEntry *tex, const uint8_t *data, rdram_interface_t *rdram)
+{
+    const TexKey *key      = &tex->key;
+    uint32_t      n_texels = (uint32_t)key->width * key->height;
+    uint16_t      tlut[256];
+    int           tlut_count = 0;
+
+    switch (FMT_SIZ(key->fmt, key->siz)) {
+        case FMT_SIZ(G_IM_FMT_CI, G_IM_SIZ_4b):
+            tlut_count = 16;
+            break;
+        case FMT_SIZ(G_IM_FMT_CI, G_IM_SIZ_8b):
+            tlut_count = 256;
+            break;
+        case FMT_SIZ(G_IM_FMT_I, G_IM_SIZ_4b):
+        case FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_4b):
+        case FMT_SIZ(G_IM_FMT_I, G_IM_SIZ_8b):
+        case FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_8b):
+        case FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_16b):
+        case FMT_SIZ(G_IM_FMT_RGBA, G_IM_SIZ_16b):
+        case FMT_SIZ(G_IM_FMT_RGBA, G_IM_SIZ_32b):
+            break;
+        // TODO YUV? but who even uses YUV (it would also be more useful to show different decoding stages..)
+        default:
+            return TEX_BAD_FMT_SIZ;
+    }
+
+    if (tlut_count != 0) {
+        // TODO previewing of CI4/CI8 textures is unreliable as the TLUT may be loaded after the index data
+        if (key->tlut == 0 || key->tlut_type == G_TT_NONE)
+            return TEX_NO_PREVIEW;
+
+        if (!rdram->read_at(tlut, key->tlut, tlut_count * sizeof(uint16_t)))
+            return TEX_READ_ERROR;
+        for (int i = 0; i < tlut_count; i++)
+            tlut[i] = BSWAP16(tlut[i]);
+    }
+
+    uint32_t *rgba = arena_alloc(cache->arena, n_texels * sizeof(uint32_t));
+    if (rgba == NULL)
+        return TEX_READ_ERROR;
+
+    for (uint32_t i = 0; i < n_texels; i++) {
+        uint32_t px = texel_bits(data, i, key->siz);
+
+        switch (FMT_SIZ(key->fmt, key->siz)) {
+            case FMT_SIZ(G_IM_FMT_I, G_IM_SIZ_4b):
+                rgba[i] = RGBA8888(CVT_CH(px, 0, 15), CVT_CH(px, 0, 15), CVT_CH(px, 0, 15), CVT_CH(px, 0, 15));
+                break;
+            case FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_4b):
+                rgba[i] = RGBA8888(CVT_CH(px, 1, 7), CVT_CH(px, 1, 7), CVT_CH(px, 1, 7), 255 * (px & 1));
+                break;
+            case FMT_SIZ(G_IM_FMT_I, G_IM_SIZ_8b):
+                rgba[i] = RGBA8888(px, px, px, px);
+                break;
+            case FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_8b):
+                rgba[i] = RGBA8888(CVT_CH(px, 4, 15), CVT_CH(px, 4, 15), CVT_CH(px, 4, 15), CVT_CH(px, 0, 15));
+                break;
+            case FMT_SIZ(G_IM_FMT_IA, G_IM_SIZ_16b):
+                rgba[i] = RGBA8888(CVT_CH(px, 8, 255), CVT_CH(px, 8, 255), CVT_CH(px, 8, 255), CVT_CH(px, 0, 255));
+                break;
+            case FMT_SIZ(G_IM_FMT_RGBA, G_IM_SIZ_16b):
+                rgba[i] = RGBA8888(CVT_CH(px, 11, 31), CVT_CH(px, 6, 31), CVT_CH(px, 1, 31), 255 * (px & 1));
+                break;
+            case FMT_SIZ(G_IM_FMT_RGBA, G_IM_SIZ_32b):
+                rgba[i] = px;
+                break;
+            case FMT_SIZ(G_IM_FMT_CI, G_IM_SIZ_4b):
+            case FMT_SIZ(G_IM_FMT_CI, G_IM_SIZ_8b):
+                rgba[i] = tlut_to_rgba(tlut[px], key->tlut_type);
+                break;
+        }
+    }
+
+    tex->rgba = rgba;
+    return TEX_OK;
+}
+
+/**
+ * Reads the texel data for `tex` into the scratch buffer. Returns NULL on failure.
+ */
+static const uint8_t *
+texcache_read(TexCache *cache, rdram_interface_t *rdram, TexEntry *tex)
+{
+    if (tex->size == 0 || tex->size > TEXCACHE_MAX_TEX_SIZE)
+        return NULL;
+
+    uint8_t *data = texcache_scratch(cache, tex->size);
+    if (data == NULL || !rdram->read_at(data, tex->key.timg, tex->size))
+        return NULL;
+    return data;
+}
+
+/**
+ * Finds the cache entry for `key`, reading and hashing the texture if it has not been seen before. If `decode` is
+ * set the texels are also decoded to RGBA8888 if they have not been already. Returns NULL only on allocation failure,
+ * read and decode failures are reported through the entry's status.
+ */
+TexEntry *
+texcache_lookup(TexCache *cache, rdram_interface_t *rdram, const TexKey *key, bool decode)
+{
+    uint64_t  key_hash = xxh64(key, sizeof(*key), 0);
+    TexEntry *tex      = hashmap_get(&cache->map, key_hash);
+
+    if (tex != NULL && memcmp(&tex->key, key, sizeof(*key)) == 0) {
+        cache->n_hits++;
+        tex->n_loads++;
+        if (decode && tex->rgba == NULL && tex->status == TEX_OK)
+            texcache_decode(cache, rdram, tex);
+        return tex;
+    }
+    cache->n_misses++;
+
+    tex = arena_alloc(cache->arena, sizeof(TexEntry));
+    if (tex == NULL)
+        return NULL;
+    memset(tex, 0, sizeof(TexEntry));
+
+    tex->key     = *key;
+    tex->size    = tex_size_bytes(key->siz, key->width, key->height);
+    tex->n_loads = 1;
+
+    const uint8_t *data = texcache_read(cache, rdram, tex);
+    if (data == NULL) {
+        tex->status = TEX_READ_ERROR;
+    } else {
+        tex->content_hash = xxh64(data, tex->size, 0);
+        tex->status       = (decode) ? texcache_decode_data(cache, tex, data, rdram) : TEX_OK;
+    }
+
+    if (hashmap_put(&cache->map, key_hash, tex) != 0 || obstack_push(&cache->entries, &tex) == NULL)
+        return NULL;
+    return tex;
+}
+
+/**
+ * Decodes the texels of a cached texture if they are not already decoded.
+ */
+enum tex_status
+texcache_decode(TexCache *cache, rdram_interface_t *rdram, TexEntry *tex)
+{
+    if (tex->rgba != NULL)
+        return TEX_OK;
+
+    const uint8_t *data = texcache_read(cache, rdram, tex);
+    if (data == NULL)
+        return tex->status = TEX_READ_ERROR;
+
+    return tex->status = texcache_decode_data(cache, tex, data, rdram);
+}
@@ -0,0 +1,70 @@
+#ifndef TEXCACHE_H_
+#define TEXCACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libgbd/rdram.h"
+#include "arena.h"
+#include "hashmap.h"
+#include "obstack.h"
+
+/**
+ *  Texture cache, remembers every distinct texture load seen during an analysis along with a hash of its contents
+ *  and (on request) the decoded texels. Keyed on everything that affects how the texels are interpreted so that a
+ *  font atlas that is re-bound for every glyph is read and decoded only once.
+ */
+
+typedef struct {
+    uint32_t timg;      /* physical address of the texture image */
+    int      fmt;       /* G_IM_FMT_* */
+    int      siz;       /* G_IM_SIZ_* */
+    int      width;     /* width in texels */
+    int      height;    /* height in texels */
+    uint32_t tlut;      /* physical address of the TLUT, 0 if none */
+    int      tlut_type; /* G_TT_* */
+} TexKey;
+
+enum tex_status {
+    TEX_BAD_FMT_SIZ = -2,
+    TEX_READ_ERROR  = -1,
+    TEX_OK          = 0,
+    TEX_NO_PREVIEW  = 1, /* CI texture without a usable TLUT */
+};
+
+typedef struct {
+    TexKey          key;
+    uint32_t        size;         /* size of the texel data in bytes */
+    uint64_t        content_hash; /* hash of the texel data, not including the TLUT */
+    enum tex_status status;       /* status of the last read or decode */
+    uint32_t       *rgba;         /* decoded texels as RGBA8888, NULL until decoded */
+    int             n_loads;      /* how many times this texture was looked up */
+} TexEntry;
+
+typedef struct {
+    Arena   *arena;   /* storage for entries and decoded texels */
+    HashMap  map;     /* key hash -> TexEntry* */
+    ObStack  entries; /* TexEntry*, in order of first lookup */
+    uint8_t *scratch;
+    size_t   scratch_size;
+    int      n_hits;
+    int      n_misses;
+} TexCache;
+
+void
+texcache_new(TexCache *cache, Arena *arena);
+
+void
+texcache_destroy(TexCache *cache);
+
+TexEntry *
+texcache_lookup(TexCache *cache, rdram_interface_t *rdram, const TexKey *key, bool decode);
+
+enum tex_status
+texcache_decode(TexCache *cache, rdram_interface_t *rdram, TexEntry *tex);
+
+uint32_t
+tex_size_bytes(int siz, int width, int height);
+
+#endif
@@ -0,0 +1,258 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gfx.h"
+#include "tmem.h"
+#include "macros.h"
+
+// Odd lines are stored with their 32-bit halves swapped so that adjacent lines can be sampled in parallel
+#define TMEM_SWAP_HALVES(w) (((w) << 32) | ((w) >> 32))
+
+#define TMEM_DXT_ODD(t) (((t) >> 11) & 1)
+
+/**
+ * Writes a single word, returns whether the word already held data from the same source.
+ */
+static ALWAYS_INLINE bool
+tmem_put(Tmem *tmem, unsigned tmem_addr, uint64_t word, uint32_t src)
+{
+    tmem_addr %= TMEM_WORDS;
+
+    bool resident = tmem->src[tmem_addr] == src;
+
+    tmem->words[tmem_addr] = word;
+    tmem->src[tmem_addr]   = src;
+    return resident;
+}
+
+static enum tmem_load_result
+tmem_load_done(Tmem *tmem, enum tmem_load_type type, uint64_t n_bytes, bool resident)
+{
+    TmemStats *stats = &tmem->stats;
+
+    stats->bytes[type] += n_bytes;
+    stats->n_loads[type]++;
+
+    if (!resident)
+        return TMEM_LOAD_OK;
+
+    stats->n_resident++;
+    stats->resident_bytes += n_bytes;
+    return TMEM_LOAD_RESIDENT;
+}
+
+/**
+ * Splits 4 texels of 32-bit data into the R/G values stored in the low half and the B/A values stored in the high half
+ */
+static void
+tmem_split_32b(const uint8_t *data, uint64_t *lo, uint64_t *hi)
+{
+    uint8_t rg[8];
+    uint8_t ba[8];
+
+    for (int i = 0; i < 4; i++) {
+        rg[i * 2 + 0] = data[i * 4 + 0];
+        rg[i * 2 + 1] = data[i * 4 + 1];
+        ba[i * 2 + 0] = data[i * 4 + 2];
+        ba[i * 2 + 1] = data[i * 4 + 3];
+    }
+    memcpy(lo, rg, sizeof(*lo));
+    memcpy(hi, ba, sizeof(*hi));
+}
+
+/**
+ * Copies `n_words` TMEM words worth of data starting at `data` into TMEM at `tmem_addr`. For 32-bit textures each word
+ * consumes 16 bytes of input split across both halves of TMEM. If `swap` is set the words are stored as an odd line.
+ * Returns whether every word written already held data from the same source.
+ */
+static bool
+tmem_copy_words(Tmem *tmem, const uint8_t *data, uint32_t addr, unsigned tmem_addr, int siz, unsigned n_words,
+                bool swap)
+{
+    uint64_t w;
+    bool     resident = true;
+
+    if (siz == G_IM_SIZ_32b) {
+        for (unsigned i = 0; i < n_words; i++) {
+            uint64_t hi;
+            unsigned dst = (tmem_addr + i) % TMEM_HIGH_WORDS;
+
+            tmem_split_32b(&data[i * 16], &w, &hi);
+            if (swap) {
+                w  = TMEM_SWAP_HALVES(w);
+                hi = TMEM_SWAP_HALVES(hi);
+            }
+            resident &= tmem_put(tmem, dst, w, addr + i * 16);
+            resident &= tmem_put(tmem, dst + TMEM_HIGH_WORDS, hi, addr + i * 16);
+        }
+    } else {
+        for (unsigned i = 0; i < n_words; i++) {
+            memcpy(&w, &data[i * 8], sizeof(w));
+            if (swap)
+                w = TMEM_SWAP_HALVES(w);
+            resident &= tmem_put(tmem, tmem_addr + i, w, addr + i * 8);
+        }
+    }
+    return resident;
+}
+
+void
+tmem_reset(Tmem *tmem)
+{
+    memset(tmem->words, 0, sizeof(tmem->words));
+    memset(tmem->src, 0xFF, sizeof(tmem->src));
+    memset(&tmem->stats, 0, sizeof(tmem->stats));
+    memset(tmem->sampled, 0, sizeof(tmem->sampled));
+    tmem->n_sampled = 0;
+}
+
+/**
+ * Emulates LoadBlock of `n_texels` texels from `addr`. The dxt counter is advanced once per TMEM word and selects
+ * which words are written as odd lines. If the source could not be read TMEM is left unchanged.
+ */
+enum tmem_load_result
+tmem_load_block(Tmem *tmem, rdram_interface_t *rdram, uint32_t addr, unsigned tmem_addr, int siz, unsigned n_texels,
+                unsigned dxt)
+{
+    unsigned n_bytes = (n_texels * G_SIZ_BITS(siz) + 7) / 8;
+    unsigned n_words;
+    unsigned word_bytes;
+
+    if (siz == G_IM_SIZ_32b) {
+        word_bytes = 16;
+        n_words    = (n_bytes + 15) / 16;
+    } else {
+        word_bytes = 8;
+        n_words    = (n_bytes + 7) / 8;
+    }
+
+    if (n_words * word_bytes > sizeof(tmem->scratch) || !rdram->read_at(tmem->scratch, addr, n_words * word_bytes))
+        return TMEM_LOAD_READ_ERROR;
+
+    // Copy runs of words that share the same line parity
+    bool     resident = true;
+    unsigned t        = 0;
+    unsigned i        = 0;
+    while (i < n_words) {
+        unsigned start = i;
+        bool     odd   = TMEM_DXT_ODD(t);
+
+        do {
+            t += dxt;
+            i++;
+        } while (i < n_words && TMEM_DXT_ODD(t) == odd);
+
+        resident &= tmem_copy_words(tmem, &tmem->scratch[start * word_bytes], addr + start * word_bytes,
+                                    tmem_addr + start, siz, i - start, odd);
+    }
+    return tmem_load_done(tmem, TMEM_LOAD_BLOCK, n_words * word_bytes, resident);
+}
+
+/**
+ * Emulates LoadTile of a `width` x `height` texel rectangle whose first line begins at `addr`, with successive lines
+ * `stride` bytes apart in RDRAM and `line` words apart in TMEM. Words between the end of a line and the start of the
+ * next line are left untouched. Lines before one that could not be read remain loaded.
+ */
+enum tmem_load_result
+tmem_load_tile(Tmem *tmem, rdram_interface_t *rdram, uint32_t addr, uint32_t stride, unsigned tmem_addr, unsigned line,
+               int siz, unsigned width, unsigned height)
+{
+    unsigned n_bytes = (width * G_SIZ_BITS(siz) + 7) / 8;
+    unsigned n_words;
+    unsigned word_bytes;
+
+    if (siz == G_IM_SIZ_32b) {
+        word_bytes = 16;
+        n_words    = (n_bytes + 15) / 16;
+    } else {
+        word_bytes = 8;
+        n_words    = (n_bytes + 7) / 8;
+    }
+
+    if (n_words * word_bytes > sizeof(tmem->scratch))
+        return TMEM_LOAD_READ_ERROR;
+
+    bool resident = true;
+
+    for (unsigned row = 0; row < height; row++) {
+        uint32_t row_addr = addr + row * stride;
+
+        if (!rdram->read_at(tmem->scratch, row_addr, n_words * word_bytes))
+            return TMEM_LOAD_READ_ERROR;
+
+        resident &= tmem_copy_words(tmem, tmem->scratch, row_addr, tmem_addr + row * line, siz, n_words, row & 1);
+    }
+    return tmem_load_done(tmem, TMEM_LOAD_TILE, (uint64_t)n_words * word_bytes * height, resident);
+}
+
+/**
+ * Emulates LoadTLUT of `count` 16-bit palette entries. Each entry is quadricated, filling an entire TMEM word.
+ */
+enum tmem_load_result
+tmem_load_tlut(Tmem *tmem, rdram_interface_t *rdram, uint32_t addr, unsigned tmem_addr, unsigned count)
+{
+    uint16_t *entries  = (uint16_t *)tmem->scratch;
+    bool      resident = true;
+
+    if (count * sizeof(uint16_t) > sizeof(tmem->scratch) || !rdram->read_at(entries, addr, count * sizeof(uint16_t)))
+        return TMEM_LOAD_READ_ERROR;
+
+    for (unsigned i = 0; i < count; i++) {
+        uint64_t e = entries[i];
+
+        resident &= tmem_put(tmem, tmem_addr + i, e | (e << 16) | (e << 32) | (e << 48), addr + i * sizeof(uint16_t));
+    }
+    return tmem_load_done(tmem, TMEM_LOAD_TLUT, count * sizeof(uint16_t), resident);
+}
+
+/**
+ * Returns the TMEM word address of the first word in the range that was never loaded, or -1 if all words were loaded.
+ */
+int
+tmem_first_unloaded(const Tmem *tmem, unsigned tmem_addr, unsigned n_words)
+{
+    for (unsigned i = 0; i < n_words && i < TMEM_WORDS; i++) {
+        unsigned w = (tmem_addr + i) % TMEM_WORDS;
+
+        if (tmem->src[w] == TMEM_SRC_NONE)
+            return w;
+    }
+    return -1;
+}
+
+/**
+ * Marks `n_words` words from `tmem_addr` as sampled by the primitive being drawn.
+ */
+void
+tmem_sample(Tmem *tmem, unsigned tmem_addr, unsigned n_words)
+{
+    for (unsigned i = 0; i < n_words && i < TMEM_WORDS; i++) {
+        unsigned w = (tmem_addr + i) % TMEM_WORDS;
+
+        if (!tmem->sampled[w]) {
+            tmem->sampled[w] = true;
+            tmem->n_sampled++;
+        }
+    }
+}
+
+/**
+ * Ends the primitive being drawn, adding the words it sampled to the statistics. Data that is loaded but no longer
+ * sampled does not count, so this measures how much of TMEM is really in use rather than how much was ever loaded.
+ */
+void
+tmem_sample_done(Tmem *tmem)
+{
+    TmemStats *stats = &tmem->stats;
+
+    if (tmem->n_sampled == 0)
+        return;
+
+    stats->n_sampling++;
+    stats->peak_sampled = MAX(stats->peak_sampled, tmem->n_sampled);
+    stats->sampled_sum += tmem->n_sampled;
+
+    memset(tmem->sampled, 0, sizeof(tmem->sampled));
+    tmem->n_sampled = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef TMEM_H_
+#define TMEM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libgbd/rdram.h"
+
+#define TMEM_SIZE       0x1000
+#define TMEM_WORDS      (TMEM_SIZE / 8)
+#define TMEM_HIGH_WORDS (TMEM_WORDS / 2) // first word of the high half, where TLUTs and 32-bit B/A channels live
+#define TMEM_SRC_NONE   0xFFFFFFFF      // word has never been loaded
+
+enum tmem_load_type {
+    TMEM_LOAD_BLOCK,
+    TMEM_LOAD_TILE,
+    TMEM_LOAD_TLUT,
+    TMEM_LOAD_TYPE_MAX
+};
+
+enum tmem_load_result {
+    TMEM_LOAD_READ_ERROR = -1,
+    TMEM_LOAD_OK         = 0,
+    TMEM_LOAD_RESIDENT   = 1, // every word loaded was already present in TMEM from the same source address
+};
+
+typedef struct {
+    uint64_t bytes[TMEM_LOAD_TYPE_MAX]; // bytes moved from RDRAM into TMEM by each kind of load
+    int      n_loads[TMEM_LOAD_TYPE_MAX];
+    int      n_resident;     // number of loads that only reloaded data that was still resident
+    uint64_t resident_bytes; // bytes moved by those loads
+    int      n_sampling;     // number of primitives that sampled TMEM
+    int      peak_sampled;   // most words sampled by a single primitive
+    uint64_t sampled_sum;    // sum of words sampled by each of those primitives, for computing the average
+} TmemStats;
+
+/**
+ *  Model of the RDP's texture memory. Words are kept in the same byte order as RDRAM. Alongside the data, the RDRAM
+ *  address each word was loaded from is recorded so that rendering can be checked against what was really loaded.
+ */
+typedef struct {
+    uint64_t  words[TMEM_WORDS];
+    uint32_t  src[TMEM_WORDS];
+    TmemStats stats;
+    bool      sampled[TMEM_WORDS]; // words sampled by the primitive being drawn
+    int       n_sampled;
+    uint8_t   scratch[2 * TMEM_SIZE]; // staging buffer for reads, large enough for a maximal 32-bit LoadBlock
+} Tmem;
+
+void
+tmem_reset(Tmem *tmem);
+
+enum tmem_load_result
+tmem_load_block(Tmem *tmem, rdram_interface_t *rdram, uint32_t addr, unsigned tmem_addr, int siz, unsigned n_texels,
+                unsigned dxt);
+
+enum tmem_load_result
+tmem_load_tile(Tmem *tmem, rdram_interface_t *rdram, uint32_t addr, uint32_t stride, unsigned tmem_addr, unsigned line,
+               int siz, unsigned width, unsigned height);
+
+enum tmem_load_result
+tmem_load_tlut(Tmem *tmem, rdram_interface_t *rdram, uint32_t addr, unsigned tmem_addr, unsigned count);
+
+int
+tmem_first_unloaded(const Tmem *tmem, unsigned tmem_addr, unsigned n_words);
+
+void
+tmem_sample(Tmem *tmem, unsigned tmem_addr, unsigned n_words);
+
+void
+tmem_sample_done(Tmem *tmem);
+
+#endif
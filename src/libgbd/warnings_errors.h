@@ -115,6 +115,9 @@ DEFINE_WARNING(CC_TEXEL1_RGBA_C2_2CYC, "TEXEL1_ALPHA input selected for CC Cycle
 DEFINE_WARNING(TRI_LEECHING_VERTS, "triangle %d references vertices that were not loaded in the last batch")
 DEFINE_WARNING(TRI_TXTR_NOPERSP, "Textured triangles rendered without texture perspective correction")
 DEFINE_WARNING(TEX_CI8_NONZERO_PAL, "Palette is non-zero for CI8 tile descriptor, will be treated as 0")
+DEFINE_WARNING(TILE_SAMPLES_UNLOADED_TMEM,
+               "Render tile %d samples TMEM that was never loaded (first at TMEM address 0x%03X)")
+DEFINE_WARNING(TLUT_NOT_LOADED, "Render tile %d is color-indexed but its palette was never loaded into TMEM")
 DEFINE_WARNING(
     RDP_LOG2_INACCURATE,
     "The log2 that RDP hardware computes for dz does not agree with the true log2 of dz, inaccuracy may result.")